@@ -0,0 +1,173 @@
+package chariot
+
+import (
+	"context"
+	"errors"
+	"time"
+)
+
+// KnapsackIncumbent is an improving solution reported by SolveKnapsackAnytime.
+type KnapsackIncumbent struct {
+	Solution  *V2Solution
+	BeamWidth int           // beam width of the library solve it started from
+	Iters     int           // iters of the library solve it started from
+	Refined   bool          // improved by local search after the library solve
+	Elapsed   time.Duration // time since the anytime solve started
+}
+
+// solveKnapsackOptions is the solve path behind knapsack() and prepared
+// handles. It applies the Go-side options stats, backend, time_budget_ms
+// and threads; with engine, lns_ms or reduce the config is solved as a
+// prepared problem.
+func solveKnapsackOptions(configJSON string, optionsJSON string) (*V2Solution, error) {
+	opts, err := parseKnapsackOptions("SolveKnapsack", optionsJSON)
+	if err != nil {
+		return nil, err
+	}
+	return solveKnapsackOptionsInto(configJSON, opts, nil)
+}
+
+// solveKnapsackOptionsInto is solveKnapsackOptions with parsed options,
+// writing into dst when it is not nil.
+func solveKnapsackOptionsInto(configJSON string, opts *KnapsackOptions, dst *V2Solution) (*V2Solution, error) {
+	if opts.Engine != "" || opts.LNS > 0 || opts.Reduce {
+		// Engines, bounds, refinement and reduction work on the column view
+		// of a prepared problem.
+		p, err := PrepareKnapsack(configJSON)
+		if err != nil {
+			return nil, err
+		}
+		defer p.Release()
+		return p.solvePrepared(&KnapsackOverrides{}, opts, dst)
+	}
+	return solveKnapsackBackend(configJSON, knapsackBackendFor(configJSON), opts, dst)
+}
+
+// solveKnapsackBackend solves configJSON on the library, which runs it on
+// backend (see knapsackBackendOf), applying the options stats, backend,
+// time_budget_ms and threads.
+func solveKnapsackBackend(configJSON string, backend string, opts *KnapsackOptions, dst *V2Solution) (*V2Solution, error) {
+	if err := checkKnapsackBackend(backend, opts.Backend); err != nil {
+		return nil, err
+	}
+	start := time.Now()
+	var sol *V2Solution
+	var err error
+	if opts.TimeBudget > 0 {
+		if sol, err = solveKnapsackAnytime(context.Background(), configJSON, backend, opts, nil, configRefiner(configJSON, opts.Seed)); err == nil {
+			sol = sol.into(dst)
+		}
+	} else {
+		sol, err = solveKnapsackParallel(configJSON, backend, opts, dst)
+	}
+	if err != nil {
+		return nil, err
+	}
+	if opts.Stats {
+		sol.setStats(time.Since(start))
+	}
+	return sol, nil
+}
+
+// SolveKnapsackAnytime solves within the time_budget_ms option and returns
+// the best solution found when the budget runs out or ctx is cancelled.
+//
+// The solver library's total does not improve with beam width or iters,
+// so the budget is not spent on wider solves. One library solve runs with
+// beam width 1 and one iteration; a running solve cannot be interrupted,
+// so it completes even past the deadline. The rest of the budget goes to
+// local search on the problem's columns (see refineLNS), which stops at the
+// deadline or when ctx is cancelled. Problems with constraints other than
+// capacity constraints are not refined, since the search does not model
+// them; their solve returns the library solution.
+//
+// The library solution and each improvement on it are sent on incumbents,
+// which may be nil, as copies that later improvements leave untouched; the
+// channel is closed on return. A send waits for the reader only until the
+// deadline or ctx ends, and is dropped then. Cancel ctx to stop once a
+// solution is good enough.
+func SolveKnapsackAnytime(ctx context.Context, configJSON string, optionsJSON string, incumbents chan<- KnapsackIncumbent) (*V2Solution, error) {
+	opts, err := parseKnapsackOptions("SolveKnapsackAnytime", optionsJSON)
+	if err == nil && opts.TimeBudget <= 0 {
+		err = errors.New("SolveKnapsackAnytime: time_budget_ms must be a positive number")
+	}
+	if err != nil {
+		if incumbents != nil {
+			close(incumbents)
+		}
+		return nil, err
+	}
+	return solveKnapsackAnytime(ctx, configJSON, knapsackBackendFor(configJSON), opts, incumbents, configRefiner(configJSON, opts.Seed))
+}
+
+// anytimeRefiner improves sol in place by local search until ctx ends,
+// passing a copy of each improvement to improved.
+type anytimeRefiner func(ctx context.Context, sol *V2Solution, improved func(*V2Solution))
+
+// configRefiner refines solutions of configJSON, preparing it only once
+// the library solve has left time to refine in.
+func configRefiner(configJSON string, seed int64) anytimeRefiner {
+	return func(ctx context.Context, sol *V2Solution, improved func(*V2Solution)) {
+		p, err := PrepareKnapsack(configJSON)
+		if err != nil {
+			return
+		}
+		defer p.Release()
+		p.anytimeRefiner(&KnapsackOverrides{}, nil, seed)(ctx, sol, improved)
+	}
+}
+
+// anytimeRefiner refines solutions of p with ov applied on its column view
+// ed, built on first use when nil. Problems that are not capacity-only
+// (see capacityOnly) are left alone.
+func (p *KnapsackPrepared) anytimeRefiner(ov *KnapsackOverrides, ed *knapsackEvalData, seed int64) anytimeRefiner {
+	return func(ctx context.Context, sol *V2Solution, improved func(*V2Solution)) {
+		if ctx.Err() != nil {
+			return
+		}
+		if ed == nil {
+			var err error
+			if ed, err = p.evalColumnsWith("SolveKnapsackAnytime", ov); err != nil {
+				return
+			}
+		}
+		if !capacityOnly(p, ed) {
+			return
+		}
+		deadline, _ := ctx.Deadline()
+		p.refineLNS(ctx, ed, sol, deadline, seed, improved)
+	}
+}
+
+// solveKnapsackAnytime is SolveKnapsackAnytime with parsed options and the
+// backend the library uses for configJSON. refine may be nil, so the
+// library solution is returned as is.
+func solveKnapsackAnytime(ctx context.Context, configJSON string, backend string, opts *KnapsackOptions, incumbents chan<- KnapsackIncumbent, refine anytimeRefiner) (*V2Solution, error) {
+	if incumbents != nil {
+		defer close(incumbents)
+	}
+	start := time.Now()
+	ctx, cancel := context.WithDeadline(ctx, start.Add(opts.TimeBudget))
+	defer cancel()
+
+	step := *opts
+	step.BeamWidth, step.Iters, step.TimeBudget, step.Backend = 1, 1, 0, ""
+	sol, err := solveKnapsackParallel(configJSON, backend, &step, nil)
+	if err != nil {
+		return nil, err
+	}
+	send := func(inc *V2Solution, refined bool) {
+		if incumbents == nil {
+			return
+		}
+		select {
+		case incumbents <- KnapsackIncumbent{Solution: inc, BeamWidth: 1, Iters: 1, Refined: refined, Elapsed: time.Since(start)}:
+		case <-ctx.Done():
+		}
+	}
+	send(sol.into(new(V2Solution)), false)
+	if refine != nil && ctx.Err() == nil {
+		refine(ctx, sol, func(inc *V2Solution) { send(inc, true) })
+	}
+	return sol, nil
+}
@@ -0,0 +1,83 @@
+package chariot
+
+import (
+	"sync"
+	"unsafe"
+)
+
+// Steady-state solves reuse their Go-side memory. The config and options
+// are handed to the solver library from pooled NUL-terminated buffers
+// instead of C.CString, so argument passing does no C allocation, and
+// callers that keep a V2Solution pass it back in (SolveKnapsackInto,
+// SolvePreparedInto) to have the selection decoded into its existing
+// storage. The library still allocates its own solution internally, which
+// the wrapper frees after decoding.
+
+// knapsackCArgsMaxPooled is the largest argument buffer returned to the
+// pool; one-off huge configs are left to the garbage collector.
+const knapsackCArgsMaxPooled = 64 << 20
+
+// knapsackCArgs holds the NUL-terminated config and options of one solve.
+type knapsackCArgs struct {
+	config, options []byte
+}
+
+var knapsackCArgPool = sync.Pool{New: func() interface{} { return new(knapsackCArgs) }}
+
+func getKnapsackCArgs() *knapsackCArgs {
+	return knapsackCArgPool.Get().(*knapsackCArgs)
+}
+
+func putKnapsackCArgs(a *knapsackCArgs) {
+	if cap(a.config) > knapsackCArgsMaxPooled {
+		a.config = nil
+	}
+	if cap(a.options) > knapsackCArgsMaxPooled {
+		a.options = nil
+	}
+	knapsackCArgPool.Put(a)
+}
+
+// cString copies s into buf with a trailing NUL and returns a pointer to
+// it for a cgo call. The library reads it only during the call and the
+// bytes hold no Go pointers, so passing Go memory is allowed.
+func cString(buf *[]byte, s string) unsafe.Pointer {
+	*buf = append(append((*buf)[:0], s...), 0)
+	return unsafe.Pointer(&(*buf)[0])
+}
+
+// reuse clears sol for a solution of n items, keeping the Select and Mask
+// storage when it is large enough.
+func (sol *V2Solution) reuse(n int) {
+	sel, mask := sol.Select, sol.Mask
+	*sol = V2Solution{NumItems: n}
+	if cap(sel) >= n {
+		sel = sel[:n]
+		clear(sel)
+	} else {
+		sel = make([]int, n)
+	}
+	if words := (n + 63) / 64; cap(mask) >= words {
+		mask = mask[:words]
+		clear(mask)
+	} else {
+		mask = NewSelectMask(n)
+	}
+	sol.Select, sol.Mask = sel, mask
+}
+
+// into returns sol copied into dst's storage, or sol itself when dst is
+// nil. Paths that build a fresh solution end with it so *Into callers get
+// their buffer back.
+func (sol *V2Solution) into(dst *V2Solution) *V2Solution {
+	if dst == nil || dst == sol {
+		return sol
+	}
+	dst.reuse(sol.NumItems)
+	sel, mask := dst.Select, dst.Mask
+	copy(sel, sol.Select)
+	copy(mask, sol.Mask)
+	*dst = *sol
+	dst.Select, dst.Mask = sel, mask
+	return dst
+}
@@ -0,0 +1,74 @@
+package chariot
+
+import (
+	"encoding/json"
+	"fmt"
+)
+
+// The solver library is chosen at build time (see the knapsack_cgo_*.go
+// build tags), and every variant exports the same C symbols, so one binary
+// links exactly one backend. The "backend" option lets callers state which
+// backend a solve must run on: "auto" (the default) accepts whatever the
+// linked library picks, anything else fails instead of silently running
+// elsewhere.
+
+// KnapsackBackend returns the backend the linked solver library runs on:
+// "cpu" or "metal". The CUDA library reports "cpu": its V2 solve runs on the
+// host.
+func KnapsackBackend() string {
+	return knapsackLibraryBackend
+}
+
+// knapsackBackendFor returns the backend the linked library uses for
+// configJSON (see knapsackBackendOf). Prepared problems work this out once
+// when they are prepared; this is for solves of a raw config.
+func knapsackBackendFor(configJSON string) string {
+	if knapsackLibraryBackend != "metal" {
+		return knapsackLibraryBackend
+	}
+	var cfg struct {
+		Mode        string                   `json:"mode"`
+		Constraints []map[string]interface{} `json:"constraints"`
+	}
+	if err := json.Unmarshal([]byte(configJSON), &cfg); err != nil {
+		return "cpu"
+	}
+	return knapsackBackendOf(cfg.Mode, cfg.Constraints)
+}
+
+// knapsackBackendOf returns the backend the linked library uses for a
+// config with the given mode and constraints. The Metal library only runs
+// mode "select" with at most one capacity constraint on the GPU; anything
+// else falls back to its CPU path, which is reported as "cpu" so callers
+// can detect it.
+func knapsackBackendOf(mode string, constraints []map[string]interface{}) string {
+	if knapsackLibraryBackend != "metal" {
+		return knapsackLibraryBackend
+	}
+	capacity := 0
+	for _, c := range constraints {
+		if c["kind"] == "capacity" {
+			capacity++
+		}
+	}
+	if (mode != "" && mode != "select") || capacity > 1 {
+		return "cpu"
+	}
+	return "metal"
+}
+
+// checkKnapsackBackend checks that ran, the backend the linked library
+// uses for the problem, is the one named by the "backend" option ("" or
+// "auto" accept any).
+func checkKnapsackBackend(ran string, backend string) error {
+	if backend == "" || backend == "auto" {
+		return nil
+	}
+	if backend != knapsackLibraryBackend {
+		return fmt.Errorf("SolveKnapsack: backend %q is not available in this build (linked: %q)", backend, knapsackLibraryBackend)
+	}
+	if ran != backend {
+		return fmt.Errorf("SolveKnapsack: backend %q cannot run this problem (would run on %q)", backend, ran)
+	}
+	return nil
+}
@@ -0,0 +1,31 @@
+package chariot
+
+import "runtime"
+
+// SolveKnapsackBatch solves many independent V2 configs with shared solver
+// options, running the instances concurrently. Results and errors are
+// indexed like configJSONs; a failed instance does not stop the others.
+//
+// The "threads" option bounds how many instances are solved at once
+// (default GOMAXPROCS); each instance is itself solved single-threaded.
+// time_budget_ms applies to each instance separately.
+func SolveKnapsackBatch(configJSONs []string, optionsJSON string) ([]*V2Solution, []error, error) {
+	opts, err := parseKnapsackOptions("SolveKnapsackBatch", optionsJSON)
+	if err != nil {
+		return nil, nil, err
+	}
+	// The options are parsed once and shared; solves only read them.
+	threads := opts.Threads
+	shared := *opts
+	shared.Threads = 0
+	if threads == 0 {
+		threads = runtime.GOMAXPROCS(0)
+	}
+
+	sols := make([]*V2Solution, len(configJSONs))
+	errs := make([]error, len(configJSONs))
+	runKnapsackPool(len(configJSONs), threads, func(i int) {
+		sols[i], errs[i] = solveKnapsackOptionsInto(configJSONs[i], &shared, nil)
+	})
+	return sols, errs, nil
+}
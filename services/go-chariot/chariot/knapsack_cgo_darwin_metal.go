@@ -13,9 +13,13 @@ package chariot
 import "C"
 import (
 	"errors"
+	"time"
 	"unsafe"
 )
 
+// knapsackLibraryBackend is the backend of the linked solver library.
+const knapsackLibraryBackend = "metal"
+
 // SolveKnapsack is the V2 entry point for macOS with Metal GPU acceleration.
 // It wraps the C API from libknapsack_metal.a built with Metal GPU support.
 //
@@ -24,44 +28,60 @@ import (
 //
 // Returns: A pointer to V2Solution with chosen items and total value/weight, or an error.
 func SolveKnapsack(configJSON string, optionsJSON string) (*V2Solution, error) {
+	sol := new(V2Solution)
+	if err := SolveKnapsackInto(configJSON, optionsJSON, sol); err != nil {
+		return nil, err
+	}
+	return sol, nil
+}
+
+// SolveKnapsackInto is SolveKnapsack writing the solution into dst, reusing
+// its Select and Mask storage when large enough (see knapsack_arena.go).
+// dst is left untouched on error.
+func SolveKnapsackInto(configJSON string, optionsJSON string, dst *V2Solution) error {
+	return solveKnapsackInto(configJSON, optionsJSON, knapsackBackendFor(configJSON), dst)
+}
+
+// solveKnapsackInto is SolveKnapsackInto reporting backend, the backend the
+// library uses for configJSON (see knapsackBackendOf), in dst.Backend.
+func solveKnapsackInto(configJSON string, optionsJSON string, backend string, dst *V2Solution) error {
 	if configJSON == "" {
-		return nil, errors.New("SolveKnapsack: empty V2 config JSON")
+		return errors.New("SolveKnapsack: empty V2 config JSON")
 	}
 
-	cCfg := C.CString(configJSON)
-	defer C.free(unsafe.Pointer(cCfg))
+	args := getKnapsackCArgs()
+	defer putKnapsackCArgs(args)
+	cCfg := (*C.char)(cString(&args.config, configJSON))
 
 	var cOpts *C.char
 	if optionsJSON != "" {
-		cOpts = C.CString(optionsJSON)
-		defer C.free(unsafe.Pointer(cOpts))
+		cOpts = (*C.char)(cString(&args.options, optionsJSON))
 	}
 
 	var out *C.KnapsackSolutionV2
+	start := time.Now()
 	rc := C.solve_knapsack_v2_from_json(cCfg, cOpts, &out)
+	native := time.Since(start)
 	if rc != 0 || out == nil {
-		return nil, errors.New("SolveKnapsack: solve_knapsack_v2_from_json failed")
+		return errors.New("SolveKnapsack: solve_knapsack_v2_from_json failed")
 	}
 	defer C.free_knapsack_solution_v2(out)
 
 	n := int(out.num_items)
-	sel := make([]int, n)
+	var ptr unsafe.Pointer
 	if n > 0 {
-		ptr := C.ks_v2_select_ptr(out) // int* ks_v2_select_ptr(KnapsackSolutionV2* sol)
-		if ptr != nil {
-			slice := (*[1 << 30]C.int)(unsafe.Pointer(ptr))[:n:n]
-			for i := 0; i < n; i++ {
-				sel[i] = int(slice[i])
-			}
-		}
+		ptr = unsafe.Pointer(C.ks_v2_select_ptr(out)) // int* ks_v2_select_ptr(KnapsackSolutionV2* sol)
 	}
+	start = time.Now()
+	dst.reuse(n)
+	decodeSelectV2Into(ptr, dst.Select, dst.Mask)
+	decode := time.Since(start)
 
 	// Convert C result to Go V2Solution
-	return &V2Solution{
-		NumItems:  n,
-		Select:    sel,
-		Objective: float64(out.objective),
-		Penalty:   float64(out.penalty),
-		Total:     float64(out.total),
-	}, nil
+	dst.Objective = float64(out.objective)
+	dst.Penalty = float64(out.penalty)
+	dst.Total = float64(out.total)
+	dst.Backend = backend
+	dst.timing = knapsackTiming{solves: 1, native: native, decode: decode}
+	return nil
 }
@@ -0,0 +1,331 @@
+package chariot
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"math"
+	"os"
+	"path/filepath"
+	"sort"
+	"unsafe"
+)
+
+// Knapsack column files hold item attributes in a fixed, mmap-friendly layout
+// so many solver workers on one host can share them through the page cache.
+//
+// Layout (all integers little-endian):
+//
+//	header    64 bytes  magic "KSCOLS\x00\x01", version u32, column count u32,
+//	                    item count u64, zero padding
+//	directory 64 bytes per column: name [48]byte (NUL padded), dtype u32,
+//	                    reserved u32, data offset u64
+//	data      one column per entry, each starting on a 64-byte boundary
+//
+// float64 columns are referenced from the V2 config in place (source=file,
+// format=binary64_le, offset_bytes); float32 columns are readable from Go
+// but cannot be bound as solver attributes.
+
+const (
+	colFileMagic      = "KSCOLS\x00\x01"
+	colFileVersion    = 1
+	colFileHeaderSize = 64
+	colFileEntrySize  = 64
+	colFileNameSize   = 48
+	colFileAlign      = 64
+)
+
+// Column data types stored in a column file.
+const (
+	ColumnFloat32 uint32 = 1
+	ColumnFloat64 uint32 = 2
+)
+
+// KnapsackColumn is one named attribute column. Exactly one of Float64 or
+// Float32 is set.
+type KnapsackColumn struct {
+	Name    string
+	Float64 []float64
+	Float32 []float32
+}
+
+func (c *KnapsackColumn) dtype() uint32 {
+	if c.Float32 != nil {
+		return ColumnFloat32
+	}
+	return ColumnFloat64
+}
+
+func (c *KnapsackColumn) len() int {
+	if c.Float32 != nil {
+		return len(c.Float32)
+	}
+	return len(c.Float64)
+}
+
+func (c *KnapsackColumn) bytes() []byte {
+	if c.Float32 == nil {
+		return float64Bytes(c.Float64)
+	}
+	if len(c.Float32) == 0 {
+		return nil
+	}
+	if hostLittleEndian {
+		return unsafe.Slice((*byte)(unsafe.Pointer(&c.Float32[0])), len(c.Float32)*4)
+	}
+	out := make([]byte, len(c.Float32)*4)
+	for i, v := range c.Float32 {
+		binary.LittleEndian.PutUint32(out[i*4:], math.Float32bits(v))
+	}
+	return out
+}
+
+// colFileEntry is one parsed directory entry.
+type colFileEntry struct {
+	dtype  uint32
+	offset int64
+}
+
+func alignUp(n int64) int64 {
+	return (n + colFileAlign - 1) &^ (colFileAlign - 1)
+}
+
+// writeColumnFile writes cols to f in column file layout. Columns are sorted
+// by name so output is deterministic.
+func writeColumnFile(f *os.File, cols []KnapsackColumn) error {
+	if len(cols) == 0 {
+		return errors.New("no columns")
+	}
+	sorted := append([]KnapsackColumn(nil), cols...)
+	sort.Slice(sorted, func(i, j int) bool { return sorted[i].Name < sorted[j].Name })
+
+	numItems := sorted[0].len()
+	for i := range sorted {
+		c := &sorted[i]
+		if c.Name == "" || len(c.Name) >= colFileNameSize {
+			return fmt.Errorf("column name %q must be 1-%d bytes", c.Name, colFileNameSize-1)
+		}
+		if i > 0 && c.Name == sorted[i-1].Name {
+			return fmt.Errorf("duplicate column %q", c.Name)
+		}
+		if c.Float64 != nil && c.Float32 != nil {
+			return fmt.Errorf("column %q sets both Float64 and Float32", c.Name)
+		}
+		if c.len() != numItems {
+			return fmt.Errorf("column %q has %d values, expected %d", c.Name, c.len(), numItems)
+		}
+	}
+
+	meta := make([]byte, colFileHeaderSize+colFileEntrySize*len(sorted))
+	copy(meta, colFileMagic)
+	binary.LittleEndian.PutUint32(meta[8:], colFileVersion)
+	binary.LittleEndian.PutUint32(meta[12:], uint32(len(sorted)))
+	binary.LittleEndian.PutUint64(meta[16:], uint64(numItems))
+
+	offsets := make([]int64, len(sorted))
+	offset := alignUp(int64(len(meta)))
+	for i := range sorted {
+		entry := meta[colFileHeaderSize+i*colFileEntrySize:]
+		copy(entry[:colFileNameSize], sorted[i].Name)
+		binary.LittleEndian.PutUint32(entry[48:], sorted[i].dtype())
+		binary.LittleEndian.PutUint64(entry[56:], uint64(offset))
+		offsets[i] = offset
+		offset = alignUp(offset + int64(len(sorted[i].bytes())))
+	}
+
+	if _, err := f.Write(meta); err != nil {
+		return err
+	}
+	for i := range sorted {
+		if _, err := f.Seek(offsets[i], 0); err != nil {
+			return err
+		}
+		if _, err := f.Write(sorted[i].bytes()); err != nil {
+			return err
+		}
+	}
+	return f.Truncate(offset)
+}
+
+// WriteKnapsackColumnFile writes cols to path. The file is written next to
+// path and renamed into place, so concurrent readers never see a partial file.
+func WriteKnapsackColumnFile(path string, cols []KnapsackColumn) error {
+	f, err := os.CreateTemp(filepath.Dir(path), "."+filepath.Base(path)+".tmp-*")
+	if err != nil {
+		return fmt.Errorf("WriteKnapsackColumnFile: %w", err)
+	}
+	tmp := f.Name()
+	if err := writeColumnFile(f, cols); err != nil {
+		f.Close()
+		os.Remove(tmp)
+		return fmt.Errorf("WriteKnapsackColumnFile: %w", err)
+	}
+	if err := f.Close(); err != nil {
+		os.Remove(tmp)
+		return fmt.Errorf("WriteKnapsackColumnFile: %w", err)
+	}
+	if err := os.Rename(tmp, path); err != nil {
+		os.Remove(tmp)
+		return fmt.Errorf("WriteKnapsackColumnFile: %w", err)
+	}
+	return nil
+}
+
+// KnapsackColumnFile is a read-only, memory-mapped column file. Column
+// accessors return views into the mapping; they are valid until Close.
+//
+// The solver reads bound columns by path, so a file replaced at that path
+// after opening (WriteKnapsackColumnFile renames over it) no longer matches
+// the mapped directory; checkCurrent reports that instead of solving
+// against the new file with the old offsets.
+type KnapsackColumnFile struct {
+	path     string
+	info     os.FileInfo // the file that was mapped
+	data     []byte
+	numItems int
+	names    []string
+	entries  map[string]colFileEntry
+}
+
+// OpenKnapsackColumnFile maps path read-only and validates its header.
+func OpenKnapsackColumnFile(path string) (*KnapsackColumnFile, error) {
+	if !hostLittleEndian {
+		return nil, errors.New("OpenKnapsackColumnFile: column files require a little-endian host")
+	}
+	abs, err := filepath.Abs(path)
+	if err != nil {
+		return nil, fmt.Errorf("OpenKnapsackColumnFile: %w", err)
+	}
+	info, err := os.Stat(abs)
+	if err != nil {
+		return nil, fmt.Errorf("OpenKnapsackColumnFile: %w", err)
+	}
+	data, err := mmapFile(abs)
+	if err != nil {
+		return nil, fmt.Errorf("OpenKnapsackColumnFile: %w", err)
+	}
+	cf := &KnapsackColumnFile{path: abs, info: info, data: data}
+	if err := cf.parse(); err != nil {
+		munmapFile(data)
+		return nil, fmt.Errorf("OpenKnapsackColumnFile: %s: %w", path, err)
+	}
+	// The file may have been replaced between Stat and the mapping.
+	if err := cf.checkCurrent(); err != nil {
+		munmapFile(data)
+		return nil, fmt.Errorf("OpenKnapsackColumnFile: %w", err)
+	}
+	return cf, nil
+}
+
+// checkCurrent reports an error when the file at cf's path is no longer the
+// one that was mapped, or the mapping no longer covers the file.
+func (cf *KnapsackColumnFile) checkCurrent() error {
+	info, err := os.Stat(cf.path)
+	if err != nil {
+		return fmt.Errorf("column file %s: %w", cf.path, err)
+	}
+	if !os.SameFile(info, cf.info) || info.Size() != int64(len(cf.data)) {
+		return fmt.Errorf("column file %s was replaced after it was opened; prepare it again", cf.path)
+	}
+	return nil
+}
+
+func (cf *KnapsackColumnFile) parse() error {
+	d := cf.data
+	if len(d) < colFileHeaderSize || string(d[:8]) != colFileMagic {
+		return errors.New("not a knapsack column file")
+	}
+	if v := binary.LittleEndian.Uint32(d[8:]); v != colFileVersion {
+		return fmt.Errorf("unsupported column file version %d", v)
+	}
+	numCols := int(binary.LittleEndian.Uint32(d[12:]))
+	numItems := binary.LittleEndian.Uint64(d[16:])
+	if numItems > math.MaxInt32 {
+		return fmt.Errorf("item count %d too large", numItems)
+	}
+	cf.numItems = int(numItems)
+	if len(d) < colFileHeaderSize+numCols*colFileEntrySize {
+		return errors.New("truncated column directory")
+	}
+
+	cf.entries = make(map[string]colFileEntry, numCols)
+	for i := 0; i < numCols; i++ {
+		entry := d[colFileHeaderSize+i*colFileEntrySize:]
+		name := string(bytes.TrimRight(entry[:colFileNameSize], "\x00"))
+		dtype := binary.LittleEndian.Uint32(entry[48:])
+		var width uint64
+		switch dtype {
+		case ColumnFloat32:
+			width = 4
+		case ColumnFloat64:
+			width = 8
+		default:
+			return fmt.Errorf("column %q has unknown dtype %d", name, dtype)
+		}
+		// Checked as uint64 so an offset past 2^63 cannot wrap negative.
+		offset := binary.LittleEndian.Uint64(entry[56:])
+		if offset%colFileAlign != 0 || offset > uint64(len(d)) || width*numItems > uint64(len(d))-offset {
+			return fmt.Errorf("column %q data out of range", name)
+		}
+		e := colFileEntry{dtype: dtype, offset: int64(offset)}
+		if _, dup := cf.entries[name]; dup {
+			return fmt.Errorf("duplicate column %q", name)
+		}
+		cf.entries[name] = e
+		cf.names = append(cf.names, name)
+	}
+	return nil
+}
+
+// Path returns the absolute path of the mapped file.
+func (cf *KnapsackColumnFile) Path() string { return cf.path }
+
+// NumItems returns the number of values per column.
+func (cf *KnapsackColumnFile) NumItems() int { return cf.numItems }
+
+// Columns returns the column names in file order.
+func (cf *KnapsackColumnFile) Columns() []string { return cf.names }
+
+// Float64 returns a zero-copy view of a float64 column.
+func (cf *KnapsackColumnFile) Float64(name string) ([]float64, bool) {
+	e, ok := cf.entries[name]
+	if !ok || e.dtype != ColumnFloat64 || cf.data == nil {
+		return nil, false
+	}
+	if cf.numItems == 0 {
+		return []float64{}, true
+	}
+	return unsafe.Slice((*float64)(unsafe.Pointer(&cf.data[e.offset])), cf.numItems), true
+}
+
+// Float32 returns a zero-copy view of a float32 column.
+func (cf *KnapsackColumnFile) Float32(name string) ([]float32, bool) {
+	e, ok := cf.entries[name]
+	if !ok || e.dtype != ColumnFloat32 || cf.data == nil {
+		return nil, false
+	}
+	if cf.numItems == 0 {
+		return []float32{}, true
+	}
+	return unsafe.Slice((*float32)(unsafe.Pointer(&cf.data[e.offset])), cf.numItems), true
+}
+
+// attributeSpec returns the solver source spec for a float64 column.
+func (cf *KnapsackColumnFile) attributeSpec(name string) (attributeSourceSpec, bool) {
+	e, ok := cf.entries[name]
+	if !ok || e.dtype != ColumnFloat64 {
+		return attributeSourceSpec{}, false
+	}
+	return attributeSourceSpec{Source: "file", Format: "binary64_le", Path: cf.path, OffsetBytes: e.offset}, true
+}
+
+// Close unmaps the file. Views returned by Float64/Float32 become invalid.
+func (cf *KnapsackColumnFile) Close() error {
+	if cf.data == nil {
+		return nil
+	}
+	err := munmapFile(cf.data)
+	cf.data = nil
+	return err
+}
@@ -0,0 +1,18 @@
+//go:build !linux && !darwin
+
+package chariot
+
+import "os"
+
+// mmapWritesVisible reports whether writes to a mapped file show up in the
+// mapping without remapping. The in-memory copy here must be patched.
+const mmapWritesVisible = false
+
+// mmapFile reads path into memory on platforms without mmap support.
+func mmapFile(path string) ([]byte, error) {
+	return os.ReadFile(path)
+}
+
+func munmapFile(data []byte) error {
+	return nil
+}
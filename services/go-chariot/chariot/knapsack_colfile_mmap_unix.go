@@ -0,0 +1,38 @@
+//go:build linux || darwin
+
+package chariot
+
+import (
+	"os"
+	"syscall"
+)
+
+// mmapWritesVisible reports whether writes to a mapped file show up in the
+// mapping without remapping.
+const mmapWritesVisible = true
+
+// mmapFile maps path read-only and shared, so every process mapping the same
+// column file is served from one copy in the page cache.
+func mmapFile(path string) ([]byte, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	fi, err := f.Stat()
+	if err != nil {
+		return nil, err
+	}
+	if fi.Size() == 0 {
+		return []byte{}, nil
+	}
+	return syscall.Mmap(int(f.Fd()), 0, int(fi.Size()), syscall.PROT_READ, syscall.MAP_SHARED)
+}
+
+func munmapFile(data []byte) error {
+	if len(data) == 0 {
+		return nil
+	}
+	return syscall.Munmap(data)
+}
@@ -0,0 +1,217 @@
+package chariot
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"math"
+	"os"
+	"runtime"
+	"unsafe"
+)
+
+// Attribute columns can be handed to the solver as raw little-endian float64
+// files instead of JSON number arrays. The V2 loader reads file-backed
+// attributes declared as
+//
+//	{"source": "file", "format": "binary64_le", "path": "...", "offset_bytes": 0}
+//
+// which skips float formatting in Go and float parsing in the solver.
+
+// attributeSourceSpec is the file-backed attribute declaration understood by
+// the V2 config loader.
+type attributeSourceSpec struct {
+	Source      string `json:"source"`
+	Format      string `json:"format"`
+	Path        string `json:"path"`
+	OffsetBytes int64  `json:"offset_bytes,omitempty"`
+}
+
+// hostLittleEndian reports whether float64 slices can be written byte-for-byte.
+var hostLittleEndian = func() bool {
+	x := uint16(1)
+	return *(*byte)(unsafe.Pointer(&x)) == 1
+}()
+
+// knapsackStagingDir returns the directory used for staged attribute columns.
+// tmpfs (/dev/shm) is preferred so staged columns never touch disk.
+func knapsackStagingDir() string {
+	if dir := os.Getenv("CHARIOT_KNAPSACK_STAGING_DIR"); dir != "" {
+		return dir
+	}
+	if runtime.GOOS == "linux" {
+		if fi, err := os.Stat("/dev/shm"); err == nil && fi.IsDir() {
+			return "/dev/shm"
+		}
+	}
+	return os.TempDir()
+}
+
+// float64Bytes views a float64 slice as its little-endian bytes. On
+// little-endian hosts this aliases the slice's backing array; otherwise the
+// values are re-encoded.
+func float64Bytes(col []float64) []byte {
+	if len(col) == 0 {
+		return nil
+	}
+	if hostLittleEndian {
+		return unsafe.Slice((*byte)(unsafe.Pointer(&col[0])), len(col)*8)
+	}
+	out := make([]byte, len(col)*8)
+	for i, v := range col {
+		binary.LittleEndian.PutUint64(out[i*8:], math.Float64bits(v))
+	}
+	return out
+}
+
+// PrepareKnapsackColumns prepares a V2 config whose attribute values are
+// supplied as Go slices rather than JSON arrays. configJSON carries
+// everything else (mode, blocks, objective, constraints). The columns are
+// staged as one column file (see WriteKnapsackColumnFile) that lives as long
+// as the returned handle and is removed by Release. items.count defaults to
+// the column length.
+func PrepareKnapsackColumns(configJSON string, columns map[string][]float64) (*KnapsackPrepared, error) {
+	if len(columns) == 0 {
+		return nil, errors.New("PrepareKnapsackColumns: no attribute columns")
+	}
+	cols := make([]KnapsackColumn, 0, len(columns))
+	for name, values := range columns {
+		cols = append(cols, KnapsackColumn{Name: name, Float64: values})
+	}
+
+	f, err := os.CreateTemp(knapsackStagingDir(), "knapsack-*.kscol")
+	if err != nil {
+		return nil, fmt.Errorf("PrepareKnapsackColumns: failed to stage columns: %w", err)
+	}
+	path := f.Name()
+	err = writeColumnFile(f, cols)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		os.Remove(path)
+		return nil, fmt.Errorf("PrepareKnapsackColumns: failed to stage columns: %w", err)
+	}
+
+	cf, err := OpenKnapsackColumnFile(path)
+	if err != nil {
+		os.Remove(path)
+		return nil, fmt.Errorf("PrepareKnapsackColumns: %w", err)
+	}
+	p, err := prepareWithColumnFile("PrepareKnapsackColumns", configJSON, cf)
+	if err != nil {
+		cf.Close()
+		os.Remove(path)
+		return nil, err
+	}
+	p.staged = []string{path}
+	return p, nil
+}
+
+// PrepareKnapsackFile prepares a V2 config whose attributes come from an
+// existing column file. Every float64 column is bound to the solver in
+// place, so workers sharing the file read it from the page cache instead of
+// each holding a copy; an attribute also declared inline in
+// items.attributes is an error. The file stays mapped until Release; it is
+// not removed. Replacing the file at path afterwards makes solves fail
+// until it is prepared again.
+func PrepareKnapsackFile(configJSON string, path string) (*KnapsackPrepared, error) {
+	cf, err := OpenKnapsackColumnFile(path)
+	if err != nil {
+		return nil, fmt.Errorf("PrepareKnapsackFile: %w", err)
+	}
+	p, err := prepareWithColumnFile("PrepareKnapsackFile", configJSON, cf)
+	if err != nil {
+		cf.Close()
+		return nil, err
+	}
+	return p, nil
+}
+
+// prepareWithColumnFile binds the float64 columns of cf into configJSON's
+// items.attributes and prepares the result. On success the handle owns cf.
+func prepareWithColumnFile(fn string, configJSON string, cf *KnapsackColumnFile) (*KnapsackPrepared, error) {
+	var root map[string]json.RawMessage
+	if err := json.Unmarshal([]byte(configJSON), &root); err != nil {
+		return nil, fmt.Errorf("%s: invalid JSON: %w", fn, err)
+	}
+	items := map[string]json.RawMessage{}
+	if raw, ok := root["items"]; ok {
+		if err := json.Unmarshal(raw, &items); err != nil {
+			return nil, fmt.Errorf("%s: items must be an object: %w", fn, err)
+		}
+	}
+	attrs := map[string]json.RawMessage{}
+	if raw, ok := items["attributes"]; ok {
+		if err := json.Unmarshal(raw, &attrs); err != nil {
+			return nil, fmt.Errorf("%s: items.attributes must be an object: %w", fn, err)
+		}
+	}
+
+	if raw, ok := items["count"]; ok {
+		var declared int
+		if err := json.Unmarshal(raw, &declared); err != nil || declared != cf.NumItems() {
+			return nil, fmt.Errorf("%s: items.count does not match column length %d", fn, cf.NumItems())
+		}
+	}
+	if cf.NumItems() == 0 {
+		return nil, fmt.Errorf("%s: items.count must be > 0", fn)
+	}
+
+	bound := 0
+	for _, name := range cf.Columns() {
+		spec, ok := cf.attributeSpec(name)
+		if !ok {
+			continue
+		}
+		if _, inline := attrs[name]; inline {
+			return nil, fmt.Errorf("%s: attribute %q is given both inline and as a column", fn, name)
+		}
+		data, _ := json.Marshal(spec)
+		attrs[name] = data
+		bound++
+	}
+	if bound == 0 {
+		return nil, fmt.Errorf("%s: column file has no float64 columns to bind", fn)
+	}
+
+	countJSON, _ := json.Marshal(cf.NumItems())
+	attrsJSON, _ := json.Marshal(attrs)
+	items["count"] = countJSON
+	items["attributes"] = attrsJSON
+	itemsJSON, _ := json.Marshal(items)
+	root["items"] = itemsJSON
+	cfg, err := json.Marshal(root)
+	if err != nil {
+		return nil, fmt.Errorf("%s: failed to marshal config: %w", fn, err)
+	}
+
+	p, err := PrepareKnapsack(string(cfg))
+	if err != nil {
+		return nil, err
+	}
+	p.columnFile = cf
+	return p, nil
+}
+
+// columnsFromMap converts a Chariot map of attr -> numeric array into columns.
+func columnsFromMap(fn string, m *MapValue) (map[string][]float64, error) {
+	columns := make(map[string][]float64, len(m.Values))
+	for name, v := range m.Values {
+		arr, ok := v.(*ArrayValue)
+		if !ok {
+			return nil, fmt.Errorf("%s column %q must be array, got %T", fn, name, v)
+		}
+		col := make([]float64, len(arr.Elements))
+		for i, e := range arr.Elements {
+			num, ok := e.(Number)
+			if !ok {
+				return nil, fmt.Errorf("%s column %q[%d] must be number, got %T", fn, name, i, e)
+			}
+			col[i] = float64(num)
+		}
+		columns[name] = col
+	}
+	return columns, nil
+}
@@ -0,0 +1,367 @@
+package chariot
+
+import (
+	"bytes"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"math"
+	"path/filepath"
+	"runtime"
+	"strconv"
+	"strings"
+	"unsafe"
+)
+
+// Item files are also accepted as CSV: a header row of column names followed
+// by one row per item. The file is mapped and split into chunks at line
+// boundaries; chunks are counted and then parsed in parallel, numeric values
+// going straight into per-column slices (the layout PrepareKnapsackColumns
+// stages). Columns that turn out not to be numeric are read again, into one
+// string arena per column. Quoted fields are supported, but not line breaks
+// inside them.
+
+// csvMinChunk is the smallest slice of the file parsed by one pool task.
+const csvMinChunk = 1 << 20
+
+// KnapsackCSV is a CSV item file loaded as columns.
+type KnapsackCSV struct {
+	NumRows int
+	Header  []string                    // column names in file order
+	Columns map[string][]float64        // numeric columns
+	Text    map[string]*KnapsackStrings // non-numeric columns
+}
+
+// KnapsackStrings holds one string per row as offsets into a single arena,
+// so a column of n names costs two allocations rather than n.
+type KnapsackStrings struct {
+	arena   []byte
+	offsets []int // row i is arena[offsets[i]:offsets[i+1]]
+}
+
+// Len returns the number of rows.
+func (s *KnapsackStrings) Len() int { return len(s.offsets) - 1 }
+
+// At returns row i. The string aliases the arena and is not copied.
+func (s *KnapsackStrings) At(i int) string {
+	b := s.arena[s.offsets[i]:s.offsets[i+1]]
+	if len(b) == 0 {
+		return ""
+	}
+	return unsafe.String(&b[0], len(b))
+}
+
+// LoadKnapsackCSV reads a CSV item file. A column is numeric when every
+// row holds a finite number there; a column of numbers with a NaN or an
+// infinity is an error. Other columns are kept as text. A UTF-8 byte order
+// mark before the header is skipped.
+func LoadKnapsackCSV(path string) (*KnapsackCSV, error) {
+	return loadKnapsackCSV(path, nil, true)
+}
+
+// csvBOM is the UTF-8 byte order mark some tools write before the header.
+var csvBOM = []byte("\xef\xbb\xbf")
+
+// loadKnapsackCSV is LoadKnapsackCSV. Columns named in need must be numeric,
+// and a row that isn't is reported as such. Without keepText, text columns
+// are dropped and their strings never collected.
+func loadKnapsackCSV(path string, need map[string]bool, keepText bool) (*KnapsackCSV, error) {
+	abs, err := filepath.Abs(path)
+	if err != nil {
+		return nil, fmt.Errorf("LoadKnapsackCSV: %w", err)
+	}
+	data, err := mmapFile(abs)
+	if err != nil {
+		return nil, fmt.Errorf("LoadKnapsackCSV: %w", err)
+	}
+	defer munmapFile(data)
+
+	line, body := csvNextLine(bytes.TrimPrefix(data, csvBOM))
+	header := csvFields(line, nil)
+	if len(header) == 0 || (len(header) == 1 && header[0] == "") {
+		return nil, fmt.Errorf("LoadKnapsackCSV: %s: missing header row", path)
+	}
+	for i := range header {
+		header[i] = strings.Clone(header[i])
+	}
+
+	// Pass 1: split at line boundaries and count rows per chunk.
+	chunks := csvChunks(body)
+	rows := make([]int, len(chunks)+1)
+	runKnapsackPool(len(chunks), len(chunks), func(k int) {
+		n := 0
+		for rest := chunks[k]; len(rest) > 0; {
+			var line []byte
+			line, rest = csvNextLine(rest)
+			if len(line) > 0 {
+				n++
+			}
+		}
+		rows[k+1] = n
+	})
+	for k := range chunks {
+		rows[k+1] += rows[k]
+	}
+	total := rows[len(chunks)]
+	if total == 0 {
+		return nil, fmt.Errorf("LoadKnapsackCSV: %s: no rows", path)
+	}
+
+	// Pass 2: parse every column as numbers into its rows. A column stops
+	// being parsed in a chunk at its first value that isn't a number, and
+	// is text if that happens in any chunk.
+	nums := make([][]float64, len(header))
+	for c := range header {
+		nums[c] = make([]float64, total)
+	}
+	notNum := make([][]int, len(chunks))    // per chunk and column: first row that isn't a number, or -1
+	nonFinite := make([][]int, len(chunks)) // likewise for NaN and infinities
+	errs := make([]error, len(chunks))
+	runKnapsackPool(len(chunks), len(chunks), func(k int) {
+		bad, inf := make([]int, len(header)), make([]int, len(header))
+		for c := range bad {
+			bad[c], inf[c] = -1, -1
+		}
+		notNum[k], nonFinite[k] = bad, inf
+		row := rows[k]
+		fields := make([]string, 0, len(header))
+		for rest := chunks[k]; len(rest) > 0; {
+			var line []byte
+			line, rest = csvNextLine(rest)
+			if len(line) == 0 {
+				continue
+			}
+			fields = csvFields(line, fields[:0])
+			if len(fields) != len(header) {
+				errs[k] = fmt.Errorf("row %d has %d fields, header has %d", row+1, len(fields), len(header))
+				return
+			}
+			for c, f := range fields {
+				if bad[c] >= 0 {
+					continue
+				}
+				v, err := strconv.ParseFloat(strings.TrimSpace(f), 64)
+				switch {
+				case err != nil && need[header[c]]:
+					errs[k] = fmt.Errorf("row %d column %q: invalid number %q", row+1, header[c], strings.Clone(f))
+					return
+				case err != nil:
+					bad[c] = row
+				case math.IsNaN(v) || math.IsInf(v, 0):
+					if inf[c] < 0 {
+						inf[c] = row
+					}
+				default:
+					nums[c][row] = v
+				}
+			}
+			row++
+		}
+	})
+	for _, err := range errs {
+		if err != nil {
+			return nil, fmt.Errorf("LoadKnapsackCSV: %s: %w", path, err)
+		}
+	}
+
+	out := &KnapsackCSV{
+		NumRows: total,
+		Header:  header,
+		Columns: map[string][]float64{},
+		Text:    map[string]*KnapsackStrings{},
+	}
+	numeric := make([]bool, len(header))
+	anyText := false
+	for c, name := range header {
+		numeric[c] = true
+		infRow := -1
+		for k := range chunks {
+			if notNum[k][c] >= 0 {
+				numeric[c] = false
+			}
+			if infRow < 0 {
+				infRow = nonFinite[k][c]
+			}
+		}
+		if !numeric[c] {
+			nums[c] = nil
+			anyText = true
+			continue
+		}
+		if infRow >= 0 {
+			return nil, fmt.Errorf("LoadKnapsackCSV: %s: row %d column %q: number is not finite", path, infRow+1, name)
+		}
+		out.Columns[name] = nums[c]
+	}
+	if !keepText || !anyText {
+		return out, nil
+	}
+
+	// Pass 3: collect the text columns into per-chunk arenas, joined below.
+	texts := make([][]KnapsackStrings, len(chunks))
+	runKnapsackPool(len(chunks), len(chunks), func(k int) {
+		local := make([]KnapsackStrings, len(header))
+		for c := range local {
+			if !numeric[c] {
+				local[c].offsets = make([]int, 1, rows[k+1]-rows[k]+1)
+			}
+		}
+		texts[k] = local
+		fields := make([]string, 0, len(header))
+		for rest := chunks[k]; len(rest) > 0; {
+			var line []byte
+			line, rest = csvNextLine(rest)
+			if len(line) == 0 {
+				continue
+			}
+			fields = csvFields(line, fields[:0])
+			for c, f := range fields {
+				if !numeric[c] {
+					t := &local[c]
+					t.arena = append(t.arena, f...)
+					t.offsets = append(t.offsets, len(t.arena))
+				}
+			}
+		}
+	})
+	for c, name := range header {
+		if numeric[c] {
+			continue
+		}
+		size := 0
+		for k := range chunks {
+			size += len(texts[k][c].arena)
+		}
+		s := &KnapsackStrings{arena: make([]byte, 0, size), offsets: make([]int, 1, total+1)}
+		for k := range chunks {
+			t := &texts[k][c]
+			base := len(s.arena)
+			s.arena = append(s.arena, t.arena...)
+			for _, off := range t.offsets[1:] {
+				s.offsets = append(s.offsets, base+off)
+			}
+		}
+		out.Text[name] = s
+	}
+	return out, nil
+}
+
+// PrepareKnapsackCSV prepares a V2 config whose attributes are the numeric
+// columns of a CSV item file (see LoadKnapsackCSV). The attributes the
+// objective and constraints name must be numeric columns. Text columns are
+// not used by the solver and are not read.
+func PrepareKnapsackCSV(configJSON string, path string) (*KnapsackPrepared, error) {
+	var cfg struct {
+		Objective []struct {
+			Attr string `json:"attr"`
+		} `json:"objective"`
+		Constraints []struct {
+			Attr string `json:"attr"`
+		} `json:"constraints"`
+	}
+	if err := json.Unmarshal([]byte(configJSON), &cfg); err != nil {
+		return nil, fmt.Errorf("PrepareKnapsackCSV: invalid JSON: %w", err)
+	}
+	need := map[string]bool{}
+	for _, t := range cfg.Objective {
+		need[t.Attr] = true
+	}
+	for _, c := range cfg.Constraints {
+		need[c.Attr] = true
+	}
+	csv, err := loadKnapsackCSV(path, need, false)
+	if err != nil {
+		return nil, err
+	}
+	if len(csv.Columns) == 0 {
+		return nil, errors.New("PrepareKnapsackCSV: no numeric columns")
+	}
+	return PrepareKnapsackColumns(configJSON, csv.Columns)
+}
+
+// csvChunks splits data into about csvMinChunk-sized pieces, each ending
+// after a newline (or at the end of data).
+func csvChunks(data []byte) [][]byte {
+	n := len(data) / csvMinChunk
+	if limit := 4 * runtime.GOMAXPROCS(0); n > limit {
+		n = limit
+	}
+	if n < 1 {
+		n = 1
+	}
+	chunks := make([][]byte, 0, n)
+	start := 0
+	for k := 1; k <= n && start < len(data); k++ {
+		end := len(data)
+		if k < n {
+			end = k * len(data) / n
+			if end < start {
+				end = start
+			}
+			if nl := bytes.IndexByte(data[end:], '\n'); nl >= 0 {
+				end += nl + 1
+			} else {
+				end = len(data)
+			}
+		}
+		chunks = append(chunks, data[start:end])
+		start = end
+	}
+	return chunks
+}
+
+// csvNextLine returns the first line of data without its line ending, and
+// the rest after it.
+func csvNextLine(data []byte) ([]byte, []byte) {
+	line, rest := data, []byte(nil)
+	if i := bytes.IndexByte(data, '\n'); i >= 0 {
+		line, rest = data[:i], data[i+1:]
+	}
+	return bytes.TrimSuffix(line, []byte{'\r'}), rest
+}
+
+// csvFields splits one line into fields, appending to dst. Unquoted fields
+// alias line; quoted fields are unescaped into new strings.
+func csvFields(line []byte, dst []string) []string {
+	for {
+		if len(line) > 0 && line[0] == '"' {
+			var b []byte
+			i := 1
+			for i < len(line) {
+				if line[i] == '"' {
+					if i+1 < len(line) && line[i+1] == '"' {
+						b = append(b, '"')
+						i += 2
+						continue
+					}
+					i++
+					break
+				}
+				b = append(b, line[i])
+				i++
+			}
+			dst = append(dst, string(b))
+			line = line[i:]
+			if j := bytes.IndexByte(line, ','); j >= 0 {
+				line = line[j+1:]
+				continue
+			}
+			return dst
+		}
+		j := bytes.IndexByte(line, ',')
+		if j < 0 {
+			return append(dst, csvString(line))
+		}
+		dst = append(dst, csvString(line[:j]))
+		line = line[j+1:]
+	}
+}
+
+// csvString views b as a string without copying. Callers copy anything
+// they keep beyond the mapped file's lifetime.
+func csvString(b []byte) string {
+	if len(b) == 0 {
+		return ""
+	}
+	return unsafe.String(&b[0], len(b))
+}
@@ -0,0 +1,341 @@
+package chariot
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"math"
+	"os"
+	"sort"
+)
+
+// KnapsackItemUpdate sets one attribute value of one item.
+type KnapsackItemUpdate struct {
+	Index int     `json:"index"`
+	Attr  string  `json:"attr"`
+	Value float64 `json:"value"`
+}
+
+// KnapsackItemDelta is a batch of item changes for ApplyDelta. Indices in
+// Update and Delete refer to the item numbering before the delta. Inserted
+// items are appended after the surviving items and must give a value for
+// every attribute.
+type KnapsackItemDelta struct {
+	Update []KnapsackItemUpdate `json:"update,omitempty"`
+	Delete []int                `json:"delete,omitempty"`
+	Insert []map[string]float64 `json:"insert,omitempty"`
+}
+
+// ApplyDelta changes items of the prepared problem in place.
+//
+// On the first delta the handle moves its attributes into a column file it
+// owns (see PrepareKnapsackColumns); a shared file passed to
+// PrepareKnapsackFile is never written. After that, updates are written
+// straight into the owned file, so the next solve reads them with no
+// re-encoding. Deletes and inserts rewrite the column file once per delta,
+// and adjust blocks: deleted items shrink their block and shift later
+// blocks down, inserted items extend the block that ends at the last
+// surviving item. Blocks given as "indices" lose their deleted items and
+// have the rest renumbered; one whose last index is the last surviving
+// item takes the inserted items.
+//
+// The whole delta is validated before anything changes. ApplyDelta waits
+// for running solves and evaluations on the handle, and they wait for it.
+func (p *KnapsackPrepared) ApplyDelta(d *KnapsackItemDelta) error {
+	p.mutMu.Lock()
+	defer p.mutMu.Unlock()
+	p.dropReduction()
+	p.evalMu.Lock()
+	defer p.evalMu.Unlock()
+	if p.released {
+		return errors.New("ApplyDelta: prepared problem has been released")
+	}
+	if err := p.ownColumnsLocked(); err != nil {
+		return err
+	}
+	cf := p.columnFile
+	n := p.numItems
+
+	for _, u := range d.Update {
+		if u.Index < 0 || u.Index >= n {
+			return fmt.Errorf("ApplyDelta: update index %d out of range [0, %d)", u.Index, n)
+		}
+		if _, ok := cf.entries[u.Attr]; !ok {
+			return fmt.Errorf("ApplyDelta: unknown attribute %q", u.Attr)
+		}
+	}
+	del := append([]int(nil), d.Delete...)
+	sort.Ints(del)
+	for i, idx := range del {
+		if idx < 0 || idx >= n {
+			return fmt.Errorf("ApplyDelta: delete index %d out of range [0, %d)", idx, n)
+		}
+		if i > 0 && idx == del[i-1] {
+			return fmt.Errorf("ApplyDelta: item %d deleted twice", idx)
+		}
+	}
+	for i, row := range d.Insert {
+		if len(row) != len(cf.names) {
+			return fmt.Errorf("ApplyDelta: insert %d must set all %d attributes", i, len(cf.names))
+		}
+		for name := range row {
+			if _, ok := cf.entries[name]; !ok {
+				return fmt.Errorf("ApplyDelta: insert %d: unknown attribute %q", i, name)
+			}
+		}
+	}
+	resize := len(del) > 0 || len(d.Insert) > 0
+	var blocks json.RawMessage
+	if resize {
+		if n-len(del)+len(d.Insert) <= 0 {
+			return errors.New("ApplyDelta: items.count must be > 0")
+		}
+		var err error
+		if blocks, err = p.deltaBlocks(del, len(d.Insert)); err != nil {
+			return err
+		}
+	}
+
+	for _, u := range d.Update {
+		if err := p.writeValueLocked(u.Attr, u.Index, u.Value); err != nil {
+			return fmt.Errorf("ApplyDelta: %w", err)
+		}
+	}
+	p.eval = nil
+
+	if !resize {
+		return nil
+	}
+	m := n - len(del) + len(d.Insert)
+	cols := make([]KnapsackColumn, 0, len(cf.names))
+	for _, name := range cf.names {
+		old, _ := cf.Float64(name)
+		col := make([]float64, 0, m)
+		prev := 0
+		for _, idx := range del {
+			col = append(col, old[prev:idx]...)
+			prev = idx + 1
+		}
+		col = append(col, old[prev:]...)
+		for _, row := range d.Insert {
+			col = append(col, row[name])
+		}
+		cols = append(cols, KnapsackColumn{Name: name, Float64: col})
+	}
+	if err := p.stageColumnsLocked(cols, m); err != nil {
+		return err
+	}
+	if blocks != nil {
+		p.setSection("blocks", blocks)
+		p.config = p.joinSections()
+	}
+	return nil
+}
+
+// ownColumnsLocked makes sure every attribute lives in a writable column
+// file owned by the handle, staging one if needed. Caller holds p.evalMu.
+func (p *KnapsackPrepared) ownColumnsLocked() error {
+	if p.ownedFile != nil {
+		return nil
+	}
+
+	attrs := map[string]json.RawMessage{}
+	if raw, ok := p.section("items"); ok {
+		var items struct {
+			Attributes map[string]json.RawMessage `json:"attributes"`
+		}
+		if err := json.Unmarshal(raw, &items); err != nil {
+			return fmt.Errorf("ApplyDelta: invalid items: %w", err)
+		}
+		attrs = items.Attributes
+	}
+	if len(attrs) == 0 {
+		return errors.New("ApplyDelta: problem has no attributes")
+	}
+
+	// A staged file already holding every attribute is reused as is.
+	if cf := p.columnFile; cf != nil && len(p.staged) > 0 && cf.Path() == p.staged[0] {
+		all := true
+		for name, raw := range attrs {
+			var spec attributeSourceSpec
+			if json.Unmarshal(raw, &spec) != nil || spec.Path != cf.Path() || len(cf.entries) != len(attrs) {
+				all = false
+				break
+			}
+			if e, ok := cf.entries[name]; !ok || e.dtype != ColumnFloat64 || e.offset != spec.OffsetBytes {
+				all = false
+				break
+			}
+		}
+		if all {
+			f, err := os.OpenFile(cf.Path(), os.O_RDWR, 0)
+			if err != nil {
+				return fmt.Errorf("ApplyDelta: %w", err)
+			}
+			p.ownedFile = f
+			return nil
+		}
+	}
+
+	cols := make([]KnapsackColumn, 0, len(attrs))
+	for name, raw := range attrs {
+		col, err := p.attributeColumn(name, raw)
+		if err != nil {
+			return fmt.Errorf("ApplyDelta: attribute %q cannot be updated: %w", name, err)
+		}
+		cols = append(cols, KnapsackColumn{Name: name, Float64: col})
+	}
+	return p.stageColumnsLocked(cols, p.numItems)
+}
+
+// stageColumnsLocked writes cols to a new owned column file, points the
+// items section at it and drops the previous file. Caller holds p.evalMu.
+func (p *KnapsackPrepared) stageColumnsLocked(cols []KnapsackColumn, numItems int) error {
+	f, err := os.CreateTemp(knapsackStagingDir(), "knapsack-*.kscol")
+	if err != nil {
+		return fmt.Errorf("ApplyDelta: failed to stage columns: %w", err)
+	}
+	path := f.Name()
+	if err := writeColumnFile(f, cols); err != nil {
+		f.Close()
+		os.Remove(path)
+		return fmt.Errorf("ApplyDelta: failed to stage columns: %w", err)
+	}
+	cf, err := OpenKnapsackColumnFile(path)
+	if err != nil {
+		f.Close()
+		os.Remove(path)
+		return fmt.Errorf("ApplyDelta: %w", err)
+	}
+
+	items := map[string]json.RawMessage{}
+	if raw, ok := p.section("items"); ok {
+		json.Unmarshal(raw, &items)
+	}
+	attrs := make(map[string]attributeSourceSpec, len(cols))
+	for _, name := range cf.Columns() {
+		attrs[name], _ = cf.attributeSpec(name)
+	}
+	items["count"], _ = json.Marshal(numItems)
+	items["attributes"], _ = json.Marshal(attrs)
+	itemsJSON, _ := json.Marshal(items)
+
+	if p.ownedFile != nil {
+		p.ownedFile.Close()
+	}
+	if p.columnFile != nil {
+		p.columnFile.Close()
+	}
+	for _, old := range p.staged {
+		os.Remove(old)
+	}
+	p.ownedFile = f
+	p.columnFile = cf
+	p.staged = []string{path}
+	p.numItems = numItems
+	p.eval = nil
+	p.evalCols = nil
+	p.setSection("items", itemsJSON)
+	p.config = p.joinSections()
+	return nil
+}
+
+// writeValueLocked overwrites one value in the owned column file.
+func (p *KnapsackPrepared) writeValueLocked(name string, index int, value float64) error {
+	e := p.columnFile.entries[name]
+	off := e.offset + int64(index)*8
+	var buf [8]byte
+	binary.LittleEndian.PutUint64(buf[:], math.Float64bits(value))
+	if _, err := p.ownedFile.WriteAt(buf[:], off); err != nil {
+		return err
+	}
+	if !mmapWritesVisible {
+		copy(p.columnFile.data[off:], buf[:])
+	}
+	return nil
+}
+
+// deltaBlocks returns the blocks section adjusted for deleting del (sorted)
+// and appending inserted items, or nil when the config has no blocks.
+func (p *KnapsackPrepared) deltaBlocks(del []int, inserted int) (json.RawMessage, error) {
+	raw, ok := p.section("blocks")
+	if !ok {
+		return nil, nil
+	}
+	var blocks []map[string]interface{}
+	if err := json.Unmarshal(raw, &blocks); err != nil {
+		return nil, fmt.Errorf("ApplyDelta: blocks must be an array of objects: %w", err)
+	}
+
+	end := p.numItems - len(del)
+	extend := -1
+	for i, b := range blocks {
+		if raw, ok := b["indices"]; ok {
+			list, ok := raw.([]interface{})
+			if !ok {
+				return nil, fmt.Errorf("ApplyDelta: block %d indices must be an array", i)
+			}
+			kept := make([]int, 0, len(list))
+			for _, v := range list {
+				f, ok := v.(float64)
+				if !ok || f != math.Trunc(f) || f < 0 || f >= float64(p.numItems) {
+					return nil, fmt.Errorf("ApplyDelta: block %d has invalid index %v", i, v)
+				}
+				idx := int(f)
+				if k := sort.SearchInts(del, idx); k == len(del) || del[k] != idx {
+					kept = append(kept, idx-k)
+				}
+			}
+			b["indices"] = kept
+			if len(kept) > 0 && kept[len(kept)-1] == end-1 {
+				extend = i
+			}
+			continue
+		}
+		start := int(termNumber(b, "start", 0))
+		count := int(termNumber(b, "count", 0))
+		before := sort.SearchInts(del, start)
+		within := sort.SearchInts(del, start+count) - before
+		start, count = start-before, count-within
+		b["start"], b["count"] = start, count
+		if start+count == end {
+			extend = i
+		}
+	}
+	if inserted > 0 {
+		if extend < 0 {
+			return nil, fmt.Errorf("ApplyDelta: no block ends at item %d to extend with inserted items", end)
+		}
+		if kept, ok := blocks[extend]["indices"].([]int); ok {
+			for j := 0; j < inserted; j++ {
+				kept = append(kept, end+j)
+			}
+			blocks[extend]["indices"] = kept
+		} else {
+			blocks[extend]["count"] = blocks[extend]["count"].(int) + inserted
+		}
+	}
+	return json.Marshal(blocks)
+}
+
+// section returns the raw value of a top-level config key.
+func (p *KnapsackPrepared) section(key string) (json.RawMessage, bool) {
+	for _, s := range p.sections {
+		if s.key == key {
+			return s.raw, true
+		}
+	}
+	return nil, false
+}
+
+// setSection replaces (or appends) a top-level config key.
+func (p *KnapsackPrepared) setSection(key string, raw json.RawMessage) {
+	for i := range p.sections {
+		if p.sections[i].key == key {
+			p.sections[i].raw = raw
+			return
+		}
+	}
+	p.sections = append(p.sections, preparedSection{key: key, raw: raw})
+}
@@ -0,0 +1,373 @@
+package chariot
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"math"
+	"math/bits"
+	"os"
+	"sync"
+)
+
+// SelectMask is a bit-packed select-mode candidate: bit i of word i/64 is
+// set when item i is selected.
+type SelectMask []uint64
+
+// NewSelectMask returns an empty mask for n items.
+func NewSelectMask(n int) SelectMask {
+	return make(SelectMask, (n+63)/64)
+}
+
+// PackSelect packs a 0/1 selection into a mask. Any non-zero entry counts as
+// selected.
+func PackSelect(sel []int) SelectMask {
+	m := NewSelectMask(len(sel))
+	for i, v := range sel {
+		if v != 0 {
+			m[i>>6] |= 1 << (uint(i) & 63)
+		}
+	}
+	return m
+}
+
+// Has reports whether item i is selected.
+func (m SelectMask) Has(i int) bool {
+	return m[i>>6]&(1<<(uint(i)&63)) != 0
+}
+
+// Set selects or deselects item i.
+func (m SelectMask) Set(i int, on bool) {
+	if on {
+		m[i>>6] |= 1 << (uint(i) & 63)
+	} else {
+		m[i>>6] &^= 1 << (uint(i) & 63)
+	}
+}
+
+// Count returns the number of selected items.
+func (m SelectMask) Count() int {
+	n := 0
+	for _, w := range m {
+		n += bits.OnesCount64(w)
+	}
+	return n
+}
+
+// Unpack expands the mask into a 0/1 selection of n items.
+func (m SelectMask) Unpack(n int) []int {
+	sel := make([]int, n)
+	for i := range sel {
+		if m.Has(i) {
+			sel[i] = 1
+		}
+	}
+	return sel
+}
+
+// SelectEval is the score of one select-mode candidate. It follows the
+// solver's CPU evaluator: capacity constraints add weight*excess^power to
+// Penalty when soft, and make the candidate infeasible when hard.
+type SelectEval struct {
+	Objective float64
+	Penalty   float64
+	Total     float64
+	Feasible  bool
+}
+
+// knapsackEvalData is the column view of a prepared problem used to score
+// candidates without going through the solver.
+type knapsackEvalData struct {
+	numItems    int
+	objective   []float64 // per-item sum of weight*attr over objective terms
+	constraints []evalConstraint
+
+	boundOnce sync.Once // computes upper, ok for upperBound
+	upper     float64
+	upperOK   bool
+}
+
+type evalConstraint struct {
+	column  []float64
+	limit   float64
+	soft    bool
+	penalty float64
+	power   float64
+}
+
+// evalParallelWords is the mask volume above which a block is scored on
+// several goroutines.
+const evalParallelWords = 1 << 14
+
+// EvaluateSelect scores a block of select-mode candidates against the
+// prepared problem with no overrides applied. Each mask must cover
+// NumItems() items. Only set bits are visited, one 64-item word at a time,
+// and all objective terms are pre-folded into a single column, so cost
+// scales with the number of selected items rather than terms*items.
+func (p *KnapsackPrepared) EvaluateSelect(masks []SelectMask) ([]SelectEval, error) {
+	out := make([]SelectEval, len(masks))
+	if err := p.EvaluateSelectInto(masks, out); err != nil {
+		return nil, err
+	}
+	return out, nil
+}
+
+// EvaluateSelectInto is EvaluateSelect writing the scores into out, which
+// must have one entry per mask. The column view stays resident on the
+// handle between calls, so a search loop that reuses its mask and result
+// buffers evaluates batch after batch with no per-candidate allocation.
+func (p *KnapsackPrepared) EvaluateSelectInto(masks []SelectMask, out []SelectEval) error {
+	if len(out) != len(masks) {
+		return fmt.Errorf("EvaluateSelect: %d results for %d masks", len(out), len(masks))
+	}
+	if err := p.refreshRLScores("EvaluateSelect"); err != nil {
+		return err
+	}
+	p.mutMu.RLock()
+	defer p.mutMu.RUnlock()
+	ed, err := p.evalColumns()
+	if err != nil {
+		return err
+	}
+	words := (ed.numItems + 63) / 64
+	for i, m := range masks {
+		if len(m) != words {
+			return fmt.Errorf("EvaluateSelect: mask %d has %d words, expected %d", i, len(m), words)
+		}
+		if tail := ed.numItems & 63; tail != 0 && m[words-1]>>uint(tail) != 0 {
+			return fmt.Errorf("EvaluateSelect: mask %d selects items past %d", i, ed.numItems)
+		}
+	}
+
+	const chunk = 64
+	chunks := (len(masks) + chunk - 1) / chunk
+	workers := 1
+	if len(masks)*words >= evalParallelWords {
+		workers = chunks
+	}
+	runKnapsackPool(chunks, workers, func(c int) {
+		end := (c + 1) * chunk
+		if end > len(masks) {
+			end = len(masks)
+		}
+		for i := c * chunk; i < end; i++ {
+			out[i] = ed.evaluate(masks[i])
+		}
+	})
+	return nil
+}
+
+func (ed *knapsackEvalData) evaluate(m SelectMask) SelectEval {
+	r := SelectEval{Objective: maskedSum(m, ed.objective), Feasible: true}
+	for k := range ed.constraints {
+		c := &ed.constraints[k]
+		excess := maskedSum(m, c.column) - c.limit
+		if excess <= 0 {
+			continue
+		}
+		if c.soft {
+			r.Penalty += c.penalty * math.Pow(excess, c.power)
+		} else {
+			r.Feasible = false
+		}
+	}
+	r.Total = r.Objective - r.Penalty
+	return r
+}
+
+// maskedSum adds col[i] for every set bit i in m.
+func maskedSum(m SelectMask, col []float64) float64 {
+	var s0, s1 float64
+	for w, word := range m {
+		base := w << 6
+		for word != 0 {
+			i := bits.TrailingZeros64(word)
+			s0 += col[base+i]
+			word &= word - 1
+			if word == 0 {
+				break
+			}
+			i = bits.TrailingZeros64(word)
+			s1 += col[base+i]
+			word &= word - 1
+		}
+	}
+	return s0 + s1
+}
+
+// evalColumns builds (once) the column view used by EvaluateSelect.
+func (p *KnapsackPrepared) evalColumns() (*knapsackEvalData, error) {
+	p.evalMu.Lock()
+	defer p.evalMu.Unlock()
+	if p.released {
+		return nil, errors.New("EvaluateSelect: prepared problem has been released")
+	}
+	if p.eval != nil {
+		return p.eval, nil
+	}
+	ed, err := p.buildEvalLocked("EvaluateSelect", p.objective, p.constraints)
+	if err != nil {
+		return nil, err
+	}
+	p.eval = ed
+	return ed, nil
+}
+
+// evalColumnsWith returns a column view with overrides applied. Without
+// overrides this is the cached view; otherwise a view is built from the
+// patched terms, sharing the decoded attribute columns.
+func (p *KnapsackPrepared) evalColumnsWith(fn string, ov *KnapsackOverrides) (*knapsackEvalData, error) {
+	if len(ov.Limits) == 0 && len(ov.Weights) == 0 {
+		return p.evalColumns()
+	}
+	objective, err := patchTerms(p.objective, "weight", ov.Weights)
+	if err != nil {
+		return nil, fmt.Errorf("%s: objective override: %w", fn, err)
+	}
+	constraints, err := patchTerms(p.constraints, "limit", ov.Limits)
+	if err != nil {
+		return nil, fmt.Errorf("%s: constraint override: %w", fn, err)
+	}
+	if objective == nil {
+		objective = p.objective
+	}
+	if constraints == nil {
+		constraints = p.constraints
+	}
+
+	p.evalMu.Lock()
+	defer p.evalMu.Unlock()
+	if p.released {
+		return nil, fmt.Errorf("%s: prepared problem has been released", fn)
+	}
+	return p.buildEvalLocked(fn, objective, constraints)
+}
+
+// buildEvalLocked folds objective terms and collects capacity constraints
+// into a column view. Decoded attribute columns are cached in p.evalCols.
+// Caller holds p.evalMu.
+func (p *KnapsackPrepared) buildEvalLocked(fn string, objective, constraints []map[string]interface{}) (*knapsackEvalData, error) {
+	var mode string
+	var attrs map[string]json.RawMessage
+	for _, s := range p.sections {
+		switch s.key {
+		case "mode":
+			json.Unmarshal(s.raw, &mode)
+		case "items":
+			var items struct {
+				Attributes map[string]json.RawMessage `json:"attributes"`
+			}
+			if err := json.Unmarshal(s.raw, &items); err != nil {
+				return nil, fmt.Errorf("%s: invalid items: %w", fn, err)
+			}
+			attrs = items.Attributes
+		}
+	}
+	if mode != "" && mode != "select" {
+		return nil, fmt.Errorf("%s: mode %q is not supported", fn, mode)
+	}
+
+	if p.evalCols == nil {
+		p.evalCols = map[string][]float64{}
+	}
+	column := func(name string) ([]float64, error) {
+		if col, ok := p.evalCols[name]; ok {
+			return col, nil
+		}
+		raw, ok := attrs[name]
+		if !ok {
+			return nil, fmt.Errorf("%s: unknown attribute %q", fn, name)
+		}
+		col, err := p.attributeColumn(name, raw)
+		if err != nil {
+			return nil, fmt.Errorf("%s: %w", fn, err)
+		}
+		p.evalCols[name] = col
+		return col, nil
+	}
+
+	ed := &knapsackEvalData{numItems: p.numItems, objective: make([]float64, p.numItems)}
+	for _, term := range objective {
+		attr, _ := term["attr"].(string)
+		col, err := column(attr)
+		if err != nil {
+			return nil, err
+		}
+		w := termNumber(term, "weight", 1)
+		for i, v := range col {
+			ed.objective[i] += w * v
+		}
+	}
+	for _, con := range constraints {
+		if kind, _ := con["kind"].(string); kind != "capacity" {
+			continue
+		}
+		attr, _ := con["attr"].(string)
+		if attr == "" {
+			continue
+		}
+		col, err := column(attr)
+		if err != nil {
+			return nil, err
+		}
+		ec := evalConstraint{column: col, limit: termNumber(con, "limit", 0), penalty: 1, power: 1}
+		ec.soft, _ = con["soft"].(bool)
+		if pen, ok := con["penalty"].(map[string]interface{}); ok {
+			ec.penalty = termNumber(pen, "weight", 1)
+			ec.power = termNumber(pen, "power", 1)
+		}
+		ed.constraints = append(ed.constraints, ec)
+	}
+	return ed, nil
+}
+
+// attributeColumn decodes one items.attributes entry: an inline number array
+// or a binary64_le file source. Columns from the handle's own column file are
+// zero-copy views.
+func (p *KnapsackPrepared) attributeColumn(name string, raw json.RawMessage) ([]float64, error) {
+	var col []float64
+	if err := json.Unmarshal(raw, &col); err == nil {
+		if len(col) != p.numItems {
+			return nil, fmt.Errorf("attribute %q has %d values, expected %d", name, len(col), p.numItems)
+		}
+		return col, nil
+	}
+
+	var spec attributeSourceSpec
+	if err := json.Unmarshal(raw, &spec); err != nil || spec.Source != "file" || spec.Format != "binary64_le" {
+		return nil, fmt.Errorf("attribute %q must be an inline array or a binary64_le file", name)
+	}
+	if cf := p.columnFile; cf != nil && spec.Path == cf.Path() {
+		// Read through the mapping that is open; the file at the path may
+		// have been replaced since.
+		e, ok := cf.entries[name]
+		if !ok || e.dtype != ColumnFloat64 || e.offset != spec.OffsetBytes {
+			return nil, fmt.Errorf("attribute %q does not match the mapped column file", name)
+		}
+		col, _ := cf.Float64(name)
+		return col, nil
+	}
+
+	data, err := os.ReadFile(spec.Path)
+	if err != nil {
+		return nil, fmt.Errorf("attribute %q: %w", name, err)
+	}
+	end := spec.OffsetBytes + int64(p.numItems)*8
+	if spec.OffsetBytes < 0 || end > int64(len(data)) {
+		return nil, fmt.Errorf("attribute %q file is shorter than %d values", name, p.numItems)
+	}
+	col = make([]float64, p.numItems)
+	for i := range col {
+		col[i] = math.Float64frombits(binary.LittleEndian.Uint64(data[spec.OffsetBytes+int64(i)*8:]))
+	}
+	return col, nil
+}
+
+// termNumber reads a numeric field of a decoded objective/constraint term.
+func termNumber(term map[string]interface{}, key string, def float64) float64 {
+	if v, ok := term[key].(float64); ok {
+		return v
+	}
+	return def
+}
@@ -0,0 +1,327 @@
+package chariot
+
+import (
+	"context"
+	"fmt"
+	"math"
+	"sort"
+)
+
+// KnapsackBound is an upper bound on the best Total of a prepared problem,
+// reported by prepared solves of capacity-only problems.
+type KnapsackBound struct {
+	Upper   float64 // LP relaxation bound on Total
+	Gap     float64 // Upper - Total
+	Optimal bool    // Total is proven optimal
+}
+
+// Engines accepted in the "engine" option.
+const (
+	knapsackEngineBeam  = "beam"  // the solver library's beam search (default)
+	knapsackEngineExact = "exact" // dynamic programming over capacity, in Go
+	knapsackEngineAuto  = "auto"  // exact when eligible and small, else beam
+)
+
+// exactMaxCells bounds items x capacity for the exact engine; each cell is
+// one bit of the table used to recover the selection. The table of best
+// values takes 64 bits per unit of capacity whatever the item count, so
+// capacity+1 is bounded by a 64th of the cells. exactAutoCells is the
+// smaller bound under which "auto" picks the exact engine.
+const (
+	exactMaxCells  = 1 << 30
+	exactAutoCells = 1 << 26
+)
+
+// exactMaxScale is the largest power of ten tried to make weights integral.
+const exactMaxScale = 1000
+
+// capacityOnly reports whether every constraint of p is a capacity
+// constraint over a non-negative column, the shape the reduction, the
+// bound and the exact engine rely on.
+func capacityOnly(p *KnapsackPrepared, ed *knapsackEvalData) bool {
+	for _, con := range p.constraints {
+		if kind, _ := con["kind"].(string); kind != "capacity" {
+			return false
+		}
+	}
+	for k := range ed.constraints {
+		for _, v := range ed.constraints[k].column {
+			if v < 0 {
+				return false
+			}
+		}
+	}
+	return true
+}
+
+// upperBound returns the LP relaxation bound of ed, computed once per
+// view, or false when the problem has a shape it does not cover. Soft
+// constraints and their penalties are dropped, which can only raise the
+// bound; with several hard constraints the tightest single-constraint bound
+// is used.
+func (ed *knapsackEvalData) upperBound(p *KnapsackPrepared) (float64, bool) {
+	ed.boundOnce.Do(func() {
+		if !capacityOnly(p, ed) {
+			return
+		}
+		bound := 0.0 // sum of positive values: the bound with no hard constraint
+		for _, v := range ed.objective {
+			if v > 0 {
+				bound += v
+			}
+		}
+		for k := range ed.constraints {
+			if c := &ed.constraints[k]; !c.soft {
+				if c.limit < 0 {
+					return
+				}
+				bound = math.Min(bound, dantzigBound(ed.objective, c.column, c.limit))
+			}
+		}
+		ed.upper, ed.upperOK = bound, true
+	})
+	return ed.upper, ed.upperOK
+}
+
+// densityOrder returns the positive-value items of zero size, and the other
+// positive-value items by value per unit size, densest first.
+func densityOrder(value, size []float64) (free, order []int) {
+	order = make([]int, 0, len(value))
+	for i, v := range value {
+		switch {
+		case v <= 0:
+		case size[i] == 0:
+			free = append(free, i)
+		default:
+			order = append(order, i)
+		}
+	}
+	sort.Slice(order, func(a, b int) bool {
+		i, j := order[a], order[b]
+		return value[i]*size[j] > value[j]*size[i]
+	})
+	return free, order
+}
+
+// dantzigBound fills limit in density order, the last item fractionally.
+func dantzigBound(value, size []float64, limit float64) float64 {
+	free, order := densityOrder(value, size)
+	var bound, used float64
+	for _, i := range free {
+		bound += value[i]
+	}
+	for _, i := range order {
+		if used+size[i] > limit {
+			return bound + value[i]*(limit-used)/size[i]
+		}
+		used += size[i]
+		bound += value[i]
+	}
+	return bound
+}
+
+// singleCapacity reports whether ed has exactly one constraint, a hard
+// capacity constraint with a non-negative column and limit.
+func singleCapacity(p *KnapsackPrepared, ed *knapsackEvalData) bool {
+	return capacityOnly(p, ed) && len(p.constraints) == 1 && len(ed.constraints) == 1 &&
+		!ed.constraints[0].soft && ed.constraints[0].limit >= 0
+}
+
+// densityFill is the integer part of the Dantzig bound: items in density
+// order up to the first that does not fit. It is optimal when the bound
+// has no fractional item.
+func densityFill(ed *knapsackEvalData) []int {
+	c := &ed.constraints[0]
+	sel, order := densityOrder(ed.objective, c.column)
+	used := 0.0
+	for _, i := range order {
+		if used+c.column[i] > c.limit {
+			break
+		}
+		used += c.column[i]
+		sel = append(sel, i)
+	}
+	return sel
+}
+
+// withBound sets sol.Bound from upper; reaching upper proves optimality.
+func (sol *V2Solution) withBound(upper float64, optimal bool) {
+	sol.Bound = &KnapsackBound{Upper: upper, Gap: upper - sol.Total, Optimal: optimal || gapClosed(upper, sol.Total)}
+}
+
+// gapClosed reports whether total meets upper up to rounding. A total
+// above upper comes from a selection that breaks a hard constraint and
+// proves nothing.
+func gapClosed(upper, total float64) bool {
+	return math.Abs(upper-total) <= 1e-9*math.Max(1, math.Abs(upper))
+}
+
+// exactProblem is the integer-weight view of a single-constraint problem.
+type exactProblem struct {
+	items    []int     // candidate items: positive value and weight, fitting alone
+	weight   []int     // scaled weight per candidate
+	always   []int     // items with positive value and zero weight
+	capacity int       // scaled limit
+	value    []float64 // ed.objective
+}
+
+// exactEligible returns the integer view of ed when the exact engine can
+// solve it within maxCells: a single hard capacity constraint (see
+// singleCapacity) with weights that are integral after scaling by a power
+// of ten up to exactMaxScale, and a scaled capacity below maxCells/64.
+// reason explains a refusal.
+func exactEligible(p *KnapsackPrepared, ed *knapsackEvalData, maxCells int) (*exactProblem, string) {
+	if !singleCapacity(p, ed) {
+		return nil, "needs a single hard capacity constraint over non-negative values"
+	}
+	c := &ed.constraints[0]
+
+	scale := 1.0
+	for ; scale <= exactMaxScale; scale *= 10 {
+		ok := true
+		for i, w := range c.column {
+			if ed.objective[i] <= 0 || w > c.limit {
+				continue
+			}
+			if x := w * scale; math.Abs(x-math.Round(x)) > 1e-9*math.Max(1, x) {
+				ok = false
+				break
+			}
+		}
+		if ok {
+			break
+		}
+	}
+	if scale > exactMaxScale {
+		return nil, fmt.Sprintf("needs weights with at most %d decimal places", int(math.Log10(exactMaxScale)))
+	}
+
+	ep := &exactProblem{value: ed.objective}
+	total := 0
+	for i, w := range c.column {
+		switch {
+		case ed.objective[i] <= 0 || w > c.limit:
+		case w == 0:
+			ep.always = append(ep.always, i)
+		default:
+			ep.items = append(ep.items, i)
+			sw := int(math.Round(w * scale))
+			ep.weight = append(ep.weight, sw)
+			total += sw
+		}
+	}
+	ep.capacity = int(math.Floor(c.limit*scale + 1e-9))
+	if ep.capacity > total {
+		ep.capacity = total
+	}
+	if ep.capacity+1 > maxCells/64 {
+		return nil, fmt.Sprintf("has too large a capacity (%d, at most %d)", ep.capacity, maxCells/64-1)
+	}
+	if cells := float64(len(ep.items)) * float64(ep.capacity+1); cells > float64(maxCells) {
+		return nil, fmt.Sprintf("is too large (%d items x capacity %d)", len(ep.items), ep.capacity)
+	}
+	return ep, ""
+}
+
+// solve runs the 0/1 knapsack DP over capacity, keeping one bit per
+// (item, capacity) to recover the selection, and returns the selected
+// items.
+func (ep *exactProblem) solve() []int {
+	width := ep.capacity + 1
+	best := make([]float64, width) // best value within each capacity
+	words := (width + 63) / 64
+	keep := make([]uint64, len(ep.items)*words)
+	for k, i := range ep.items {
+		w, v := ep.weight[k], ep.value[i]
+		row := keep[k*words : (k+1)*words]
+		for c := ep.capacity; c >= w; c-- {
+			if cand := best[c-w] + v; cand > best[c] {
+				best[c] = cand
+				row[c>>6] |= 1 << (uint(c) & 63)
+			}
+		}
+	}
+
+	sel := append([]int(nil), ep.always...)
+	c := ep.capacity
+	for k := len(ep.items) - 1; k >= 0 && c > 0; k-- {
+		if keep[k*words+c>>6]&(1<<(uint(c)&63)) != 0 {
+			sel = append(sel, ep.items[k])
+			c -= ep.weight[k]
+		}
+	}
+	return sel
+}
+
+// solveEngine runs the Go-side engines. "exact" solves by dynamic
+// programming and fails on problems it cannot take. "auto" does the same
+// when the problem is small (exactAutoCells); otherwise, for a single
+// capacity constraint, it returns the density fill when that already meets
+// upper. A nil solution means the beam search should run.
+func (p *KnapsackPrepared) solveEngine(engine string, ed *knapsackEvalData, upper float64) (*V2Solution, error) {
+	if engine == "" || engine == knapsackEngineBeam {
+		return nil, nil
+	}
+	maxCells := exactMaxCells
+	if engine == knapsackEngineAuto {
+		maxCells = exactAutoCells
+	}
+	ep, reason := exactEligible(p, ed, maxCells)
+	if ep != nil {
+		sol := solutionFromItems(ed, ep.solve())
+		sol.withBound(upper, true)
+		return sol, nil
+	}
+	if engine == knapsackEngineExact {
+		return nil, fmt.Errorf("SolvePrepared: engine exact: problem %s", reason)
+	}
+	if !singleCapacity(p, ed) {
+		return nil, nil
+	}
+	sol := solutionFromItems(ed, densityFill(ed))
+	if sol.withBound(upper, false); !sol.Bound.Optimal {
+		return nil, nil
+	}
+	return sol, nil
+}
+
+// solutionFromItems builds a Go-side solution selecting items.
+func solutionFromItems(ed *knapsackEvalData, items []int) *V2Solution {
+	mask := NewSelectMask(ed.numItems)
+	for _, i := range items {
+		mask.Set(i, true)
+	}
+	ev := ed.evaluate(mask)
+	return &V2Solution{
+		NumItems:  ed.numItems,
+		Select:    mask.Unpack(ed.numItems),
+		Mask:      mask,
+		Objective: ev.Objective,
+		Penalty:   ev.Penalty,
+		Total:     ev.Total,
+		Backend:   "go",
+	}
+}
+
+// solveToBound runs an anytime solve of configJSON, which the library runs
+// on backend, refined by refine. It stops as soon as an incumbent reaches
+// a finite upper, since nothing can improve on it.
+func solveToBound(configJSON string, backend string, opts *KnapsackOptions, upper float64, refine anytimeRefiner) (*V2Solution, error) {
+	if err := checkKnapsackBackend(backend, opts.Backend); err != nil {
+		return nil, err
+	}
+	if math.IsInf(upper, 1) {
+		return solveKnapsackAnytime(context.Background(), configJSON, backend, opts, nil, refine)
+	}
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	incumbents := make(chan KnapsackIncumbent)
+	go func() {
+		for inc := range incumbents {
+			if gapClosed(upper, inc.Solution.Total) {
+				cancel()
+			}
+		}
+	}()
+	return solveKnapsackAnytime(ctx, configJSON, backend, opts, incumbents, refine)
+}
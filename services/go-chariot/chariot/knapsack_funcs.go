@@ -3,16 +3,23 @@ package chariot
 import (
 	"encoding/json"
 	"fmt"
+	"math"
+	"path/filepath"
+	"strings"
+	"time"
 )
 
 // RegisterKnapsackFunctions registers the knapsack() closure for Chariot scripts.
 // This closure wraps the V2 cgo SolveKnapsack API exposed by platform-specific files.
 func RegisterKnapsackFunctions(rt *Runtime) {
 	// knapsack(configJSON, [optionsJSON]) -> map
-	// Returns: { numItems: int, select: [0|1,...], objective: float, penalty: float, total: float }
+	// Returns: { numItems: int, select: [0|1,...], objective: float, penalty: float, total: float, backend: string }
 	//
 	// The configJSON should be a V2 knapsack config (see knapsack/docs/v2/).
 	// optionsJSON is optional and can include: beam_width, iters, seed, debug, dom_enable, etc.
+	// threads adds deterministic seeded refinement workers (see SolveKnapsackParallel);
+	// time_budget_ms returns the best solution found in time (see SolveKnapsackAnytime);
+	// backend ("auto", "cpu", "cuda", "metal") fails the solve if it would run elsewhere.
 	rt.Register("knapsack", func(args ...Value) (Value, error) {
 		if len(args) < 1 {
 			return nil, fmt.Errorf("knapsack requires at least 1 argument: configJSON (string), optional optionsJSON (string)")
@@ -43,7 +50,7 @@ func RegisterKnapsackFunctions(rt *Runtime) {
 		}
 
 		// Call the V2 cgo API (platform-specific implementations)
-		sol, err := SolveKnapsack(string(configJSON), optionsJSON)
+		sol, err := solveKnapsackOptions(string(configJSON), optionsJSON)
 		if err != nil {
 			if rt.logWriter != nil {
 				rt.WriteLog("ERROR", fmt.Sprintf("knapsack() SolveKnapsack failed: %v", err))
@@ -55,20 +62,448 @@ func RegisterKnapsackFunctions(rt *Runtime) {
 			rt.WriteLog("DEBUG", fmt.Sprintf("knapsack() returned solution: numItems=%d, total=%f", sol.NumItems, sol.Total))
 		}
 
-		// Convert V2Solution to Chariot map
-		selectArr := NewArray()
-		for _, v := range sol.Select {
-			selectArr.Append(Number(v))
+		return v2SolutionToMap(sol), nil
+	})
+
+	// knapsackBatch(configs, [optionsJSON]) -> array of maps
+	// Solves an array of independent V2 configs concurrently with shared
+	// options. Each element of the result is the map knapsack() returns for
+	// the config at the same index. threads bounds concurrent solves.
+	rt.Register("knapsackBatch", func(args ...Value) (Value, error) {
+		if len(args) < 1 || len(args) > 2 {
+			return nil, fmt.Errorf("knapsackBatch requires 1-2 arguments: configs (array of strings), optional optionsJSON (string)")
+		}
+
+		configsArr, ok := args[0].(*ArrayValue)
+		if !ok {
+			return nil, fmt.Errorf("knapsackBatch arg 0 (configs) must be array, got %T", args[0])
+		}
+		configs := make([]string, len(configsArr.Elements))
+		for i, e := range configsArr.Elements {
+			cfg, ok := e.(Str)
+			if !ok {
+				return nil, fmt.Errorf("knapsackBatch configs[%d] must be string, got %T", i, e)
+			}
+			configs[i] = string(cfg)
+		}
+
+		var optionsJSON string
+		if len(args) == 2 {
+			opts, ok := args[1].(Str)
+			if !ok {
+				return nil, fmt.Errorf("knapsackBatch arg 1 (optionsJSON) must be string, got %T", args[1])
+			}
+			optionsJSON = string(opts)
+		}
+
+		sols, errs, err := SolveKnapsackBatch(configs, optionsJSON)
+		if err != nil {
+			return nil, fmt.Errorf("knapsack solve failed: %w", err)
+		}
+		// A failed instance gets a map with only "error", so one bad config
+		// does not discard the other solutions.
+		results := NewArray()
+		for i, sol := range sols {
+			if errs[i] != nil {
+				if rt.logWriter != nil {
+					rt.WriteLog("ERROR", fmt.Sprintf("knapsackBatch() config %d failed: %v", i, errs[i]))
+				}
+				failed := NewMap()
+				failed.Values["error"] = Str(errs[i].Error())
+				results.Append(failed)
+				continue
+			}
+			results.Append(v2SolutionToMap(sol))
+		}
+		return results, nil
+	})
+
+	// knapsackPrepare(configJSON, [columns]) -> KnapsackPrepared handle
+	// Parses and validates a V2 config once so it can be solved many times
+	// with knapsackSolvePrepared. Release with knapsackRelease.
+	//
+	// columns is optional: either a map of attr -> numeric array, staged as a
+	// binary column file instead of JSON arrays, or the path (under the data
+	// path) of a column file written by knapsackWriteColumns. A path ending
+	// in .csv is loaded as a CSV item file whose numeric columns become the
+	// attributes (see LoadKnapsackCSV). Either way configJSON only needs mode,
+	// blocks, objective and constraints.
+	rt.Register("knapsackPrepare", func(args ...Value) (Value, error) {
+		if len(args) < 1 || len(args) > 2 {
+			return nil, fmt.Errorf("knapsackPrepare requires 1-2 arguments: configJSON (string), optional columns (map or column file path)")
+		}
+
+		configJSON, ok := args[0].(Str)
+		if !ok {
+			return nil, fmt.Errorf("knapsackPrepare arg 0 (configJSON) must be string, got %T", args[0])
+		}
+
+		var prepared *KnapsackPrepared
+		var err error
+		if len(args) == 2 {
+			switch cols := args[1].(type) {
+			case *MapValue:
+				columns, cerr := columnsFromMap("knapsackPrepare", cols)
+				if cerr != nil {
+					return nil, cerr
+				}
+				prepared, err = PrepareKnapsackColumns(string(configJSON), columns)
+			case Str:
+				fullPath, perr := getSecureFilePath(string(cols), "data")
+				if perr != nil {
+					return nil, fmt.Errorf("knapsackPrepare: %w", perr)
+				}
+				if strings.EqualFold(filepath.Ext(fullPath), ".csv") {
+					prepared, err = PrepareKnapsackCSV(string(configJSON), fullPath)
+				} else {
+					prepared, err = PrepareKnapsackFile(string(configJSON), fullPath)
+				}
+			default:
+				return nil, fmt.Errorf("knapsackPrepare arg 1 (columns) must be map or column file path, got %T", args[1])
+			}
+		} else {
+			prepared, err = PrepareKnapsack(string(configJSON))
+		}
+		if err != nil {
+			return nil, fmt.Errorf("knapsackPrepare failed: %w", err)
+		}
+		return prepared, nil
+	})
+
+	// knapsackSolvePrepared(handle, [overridesJSON], [optionsJSON]) -> map
+	// Returns the same map as knapsack().
+	//
+	// overridesJSON patches the prepared config for this solve only:
+	//   {"limits": {"weight": 40.0}, "weights": {"value": 2.0}}
+	// limits are keyed by constraint attr, weights by objective attr.
+	rt.Register("knapsackSolvePrepared", func(args ...Value) (Value, error) {
+		if len(args) < 1 || len(args) > 3 {
+			return nil, fmt.Errorf("knapsackSolvePrepared requires 1-3 arguments: handle, optional overridesJSON (string), optional optionsJSON (string)")
+		}
+
+		prepared, err := knapsackPreparedArg("knapsackSolvePrepared", args[0])
+		if err != nil {
+			return nil, err
+		}
+
+		var overridesJSON, optionsJSON string
+		if len(args) >= 2 {
+			ov, ok := args[1].(Str)
+			if !ok {
+				return nil, fmt.Errorf("knapsackSolvePrepared arg 1 (overridesJSON) must be string, got %T", args[1])
+			}
+			overridesJSON = string(ov)
+		}
+		if len(args) == 3 {
+			opts, ok := args[2].(Str)
+			if !ok {
+				return nil, fmt.Errorf("knapsackSolvePrepared arg 2 (optionsJSON) must be string, got %T", args[2])
+			}
+			optionsJSON = string(opts)
+		}
+
+		sol, err := prepared.SolvePrepared(overridesJSON, optionsJSON)
+		if err != nil {
+			if rt.logWriter != nil {
+				rt.WriteLog("ERROR", fmt.Sprintf("knapsackSolvePrepared() failed: %v", err))
+			}
+			return nil, fmt.Errorf("knapsack solve failed: %w", err)
+		}
+		return v2SolutionToMap(sol), nil
+	})
+
+	// knapsackResolve(handle, prior, [overridesJSON]) -> map
+	// Warm re-solve of a prepared problem from a previous selection (a 0/1
+	// array, or a solution map from knapsack()/knapsackSolvePrepared()).
+	// Returns the same map as knapsack(). See KnapsackPrepared.SolveWarm.
+	rt.Register("knapsackResolve", func(args ...Value) (Value, error) {
+		if len(args) < 2 || len(args) > 3 {
+			return nil, fmt.Errorf("knapsackResolve requires 2-3 arguments: handle, prior (0/1 array or solution map), optional overridesJSON (string)")
+		}
+
+		prepared, err := knapsackPreparedArg("knapsackResolve", args[0])
+		if err != nil {
+			return nil, err
+		}
+
+		prior := args[1]
+		if tvar, ok := prior.(ScopeEntry); ok {
+			prior = tvar.Value
+		}
+		if m, ok := prior.(*MapValue); ok {
+			prior = m.Values["select"]
+		}
+		priorArr, ok := prior.(*ArrayValue)
+		if !ok {
+			return nil, fmt.Errorf("knapsackResolve arg 1 (prior) must be 0/1 array or solution map, got %T", args[1])
+		}
+		n := prepared.NumItems()
+		if len(priorArr.Elements) != n {
+			return nil, fmt.Errorf("knapsackResolve prior has %d entries, expected %d", len(priorArr.Elements), n)
+		}
+		mask := NewSelectMask(n)
+		for i, v := range priorArr.Elements {
+			num, ok := v.(Number)
+			if !ok {
+				return nil, fmt.Errorf("knapsackResolve prior[%d] must be number, got %T", i, v)
+			}
+			mask.Set(i, num != 0)
+		}
+
+		var overridesJSON string
+		if len(args) == 3 {
+			ov, ok := args[2].(Str)
+			if !ok {
+				return nil, fmt.Errorf("knapsackResolve arg 2 (overridesJSON) must be string, got %T", args[2])
+			}
+			overridesJSON = string(ov)
+		}
+
+		sol, err := prepared.SolveWarm(mask, overridesJSON)
+		if err != nil {
+			return nil, fmt.Errorf("knapsack solve failed: %w", err)
+		}
+		return v2SolutionToMap(sol), nil
+	})
+
+	// knapsackEvaluate(handle, selections) -> array of maps
+	// Scores select-mode candidates against a prepared problem without
+	// running the solver. selections is an array of 0/1 arrays, one per
+	// candidate. Each result is { objective, penalty, total, feasible }.
+	rt.Register("knapsackEvaluate", func(args ...Value) (Value, error) {
+		if len(args) != 2 {
+			return nil, fmt.Errorf("knapsackEvaluate requires 2 arguments: handle, selections (array of 0/1 arrays)")
+		}
+
+		prepared, err := knapsackPreparedArg("knapsackEvaluate", args[0])
+		if err != nil {
+			return nil, err
+		}
+		selsArr, ok := args[1].(*ArrayValue)
+		if !ok {
+			return nil, fmt.Errorf("knapsackEvaluate arg 1 (selections) must be array, got %T", args[1])
+		}
+
+		n := prepared.NumItems()
+		words := len(NewSelectMask(n))
+		backing := make([]uint64, words*len(selsArr.Elements))
+		masks := make([]SelectMask, len(selsArr.Elements))
+		for c, e := range selsArr.Elements {
+			sel, ok := e.(*ArrayValue)
+			if !ok {
+				return nil, fmt.Errorf("knapsackEvaluate selections[%d] must be array, got %T", c, e)
+			}
+			if len(sel.Elements) != n {
+				return nil, fmt.Errorf("knapsackEvaluate selections[%d] has %d entries, expected %d", c, len(sel.Elements), n)
+			}
+			m := SelectMask(backing[c*words : (c+1)*words : (c+1)*words])
+			for i, v := range sel.Elements {
+				num, ok := v.(Number)
+				if !ok {
+					return nil, fmt.Errorf("knapsackEvaluate selections[%d][%d] must be number, got %T", c, i, v)
+				}
+				m.Set(i, num != 0)
+			}
+			masks[c] = m
+		}
+
+		evals, err := prepared.EvaluateSelect(masks)
+		if err != nil {
+			return nil, fmt.Errorf("knapsackEvaluate failed: %w", err)
+		}
+		results := make([]Value, len(evals))
+		for i, ev := range evals {
+			m := NewMap()
+			m.Values["objective"] = Number(ev.Objective)
+			m.Values["penalty"] = Number(ev.Penalty)
+			m.Values["total"] = Number(ev.Total)
+			m.Values["feasible"] = Bool(ev.Feasible)
+			results[i] = m
+		}
+		return NewArrayWithValues(results), nil
+	})
+
+	// knapsackWriteColumns(path, columns) -> true
+	// path is resolved under the data path. Writes a map of attr -> numeric array as a float64 column file that
+	// knapsackPrepare(configJSON, path) can map. The file is replaced
+	// atomically, so workers that already mapped the old file are unaffected.
+	rt.Register("knapsackWriteColumns", func(args ...Value) (Value, error) {
+		if len(args) != 2 {
+			return nil, fmt.Errorf("knapsackWriteColumns requires 2 arguments: path (string), columns (map)")
+		}
+
+		path, ok := args[0].(Str)
+		if !ok {
+			return nil, fmt.Errorf("knapsackWriteColumns arg 0 (path) must be string, got %T", args[0])
+		}
+		colsMap, ok := args[1].(*MapValue)
+		if !ok {
+			return nil, fmt.Errorf("knapsackWriteColumns arg 1 (columns) must be map, got %T", args[1])
+		}
+		columns, err := columnsFromMap("knapsackWriteColumns", colsMap)
+		if err != nil {
+			return nil, err
 		}
 
-		result := NewMap()
-		result.Values["numItems"] = Number(sol.NumItems)
-		result.Values["select"] = selectArr
-		result.Values["objective"] = Number(sol.Objective)
-		result.Values["penalty"] = Number(sol.Penalty)
-		result.Values["total"] = Number(sol.Total)
+		cols := make([]KnapsackColumn, 0, len(columns))
+		for name, values := range columns {
+			cols = append(cols, KnapsackColumn{Name: name, Float64: values})
+		}
+		fullPath, err := getSecureFilePath(string(path), "data")
+		if err != nil {
+			return nil, fmt.Errorf("knapsackWriteColumns: %w", err)
+		}
+		if err := WriteKnapsackColumnFile(fullPath, cols); err != nil {
+			return nil, err
+		}
+		return Bool(true), nil
+	})
 
-		return result, nil
+	// knapsackUpdate(handle, deltaJSON) -> number of items
+	// Changes items of a prepared problem in place:
+	//   {"update": [{"index": 3, "attr": "value", "value": 9.5}],
+	//    "delete": [7, 12],
+	//    "insert": [{"value": 4.0, "weight": 2.0}]}
+	// Indices refer to the numbering before the delta; inserted items are
+	// appended. See KnapsackPrepared.ApplyDelta.
+	rt.Register("knapsackUpdate", func(args ...Value) (Value, error) {
+		if len(args) != 2 {
+			return nil, fmt.Errorf("knapsackUpdate requires 2 arguments: handle, deltaJSON (string)")
+		}
+
+		prepared, err := knapsackPreparedArg("knapsackUpdate", args[0])
+		if err != nil {
+			return nil, err
+		}
+		deltaJSON, ok := args[1].(Str)
+		if !ok {
+			return nil, fmt.Errorf("knapsackUpdate arg 1 (deltaJSON) must be string, got %T", args[1])
+		}
+
+		var delta KnapsackItemDelta
+		if err := json.Unmarshal([]byte(deltaJSON), &delta); err != nil {
+			return nil, fmt.Errorf("knapsackUpdate: invalid delta JSON: %w", err)
+		}
+		if err := prepared.ApplyDelta(&delta); err != nil {
+			return nil, fmt.Errorf("knapsackUpdate failed: %w", err)
+		}
+		return Number(prepared.NumItems()), nil
+	})
+
+	// knapsackBindRL(handle, attr, rlHandle, features) -> true
+	// Fills objective attribute attr from rlHandle's scores before every
+	// solve, rescoring items only after the RL model learns. features holds
+	// each item's features in item order: a numeric array or float32Buffer
+	// of feat_dim values per item, or one Array of [index, value] pairs per
+	// item (as rlScoreSparse). See KnapsackPrepared.BindRLScores.
+	rt.Register("knapsackBindRL", func(args ...Value) (Value, error) {
+		if len(args) != 4 {
+			return nil, fmt.Errorf("knapsackBindRL requires 4 arguments: handle, attr (string), rlHandle, features")
+		}
+
+		prepared, err := knapsackPreparedArg("knapsackBindRL", args[0])
+		if err != nil {
+			return nil, err
+		}
+		for i, arg := range args[1:] {
+			if tvar, ok := arg.(ScopeEntry); ok {
+				args[i+1] = tvar.Value
+			}
+		}
+		attr, ok := args[1].(Str)
+		if !ok {
+			return nil, fmt.Errorf("knapsackBindRL arg 1 (attr) must be string, got %T", args[1])
+		}
+		rlHandle, ok := args[2].(*RLHandle)
+		if !ok {
+			return nil, fmt.Errorf("knapsackBindRL arg 2 (rlHandle) must be RL handle from rlInit, got %T", args[2])
+		}
+
+		if arr, ok := args[3].(*ArrayValue); ok && len(arr.Elements) > 0 {
+			if _, nested := arr.Elements[0].(*ArrayValue); nested {
+				batch, err := rlSparseCandidates(arr)
+				if err != nil {
+					return nil, err
+				}
+				if err := prepared.BindRLScoresSparse(string(attr), rlHandle, batch); err != nil {
+					return nil, fmt.Errorf("knapsackBindRL failed: %w", err)
+				}
+				return Bool(true), nil
+			}
+		}
+		_, features, featDim, err := rlScoreArgs("knapsackBindRL", []Value{rlHandle, args[3], Number(rlHandle.FeatDim())})
+		if err != nil {
+			return nil, err
+		}
+		if err := prepared.BindRLScores(string(attr), rlHandle, features, featDim); err != nil {
+			return nil, fmt.Errorf("knapsackBindRL failed: %w", err)
+		}
+		return Bool(true), nil
+	})
+
+	// knapsackInvalidateRL(handle, [items]) -> true
+	// Marks items whose features changed in place (in a float32Buffer bound
+	// by knapsackBindRL) so the next solve rescores them. With no items,
+	// every item is rescored. See KnapsackPrepared.InvalidateRLScores.
+	rt.Register("knapsackInvalidateRL", func(args ...Value) (Value, error) {
+		if len(args) < 1 || len(args) > 2 {
+			return nil, fmt.Errorf("knapsackInvalidateRL requires 1-2 arguments: handle, [items]")
+		}
+
+		prepared, err := knapsackPreparedArg("knapsackInvalidateRL", args[0])
+		if err != nil {
+			return nil, err
+		}
+		var items []int
+		if len(args) == 2 {
+			arg := args[1]
+			if tvar, ok := arg.(ScopeEntry); ok {
+				arg = tvar.Value
+			}
+			arr, ok := arg.(*ArrayValue)
+			if !ok {
+				return nil, fmt.Errorf("knapsackInvalidateRL arg 1 (items) must be array, got %T", arg)
+			}
+			items = make([]int, len(arr.Elements))
+			for k, v := range arr.Elements {
+				num, ok := v.(Number)
+				if !ok || num != Number(math.Trunc(float64(num))) {
+					return nil, fmt.Errorf("knapsackInvalidateRL items[%d] must be an item index, got %v", k, v)
+				}
+				items[k] = int(num)
+			}
+			if len(items) == 0 {
+				return Bool(true), nil
+			}
+		}
+		if err := prepared.InvalidateRLScores(items...); err != nil {
+			return nil, fmt.Errorf("knapsackInvalidateRL failed: %w", err)
+		}
+		return Bool(true), nil
+	})
+
+	// knapsackRelease(handle) -> true
+	// Drops the resident config held by a knapsackPrepare handle.
+	rt.Register("knapsackRelease", func(args ...Value) (Value, error) {
+		if len(args) != 1 {
+			return nil, fmt.Errorf("knapsackRelease requires 1 argument: handle")
+		}
+
+		prepared, err := knapsackPreparedArg("knapsackRelease", args[0])
+		if err != nil {
+			return nil, err
+		}
+		prepared.Release()
+		return Bool(true), nil
+	})
+
+	// knapsackBackend() -> "cpu" | "metal"
+	// Reports the backend of the linked solver library.
+	rt.Register("knapsackBackend", func(args ...Value) (Value, error) {
+		if len(args) != 0 {
+			return nil, fmt.Errorf("knapsackBackend takes no arguments")
+		}
+		return Str(KnapsackBackend()), nil
 	})
 
 	// knapsackConfig(items, capacity, weights, values, [constraints]) -> configJSON string
@@ -175,3 +610,68 @@ func RegisterKnapsackFunctions(rt *Runtime) {
 		return Str(configJSON), nil
 	})
 }
+
+// v2SolutionToMap converts a V2Solution into the map returned by knapsack().
+func v2SolutionToMap(sol *V2Solution) *MapValue {
+	elems := make([]Value, len(sol.Select))
+	for i, v := range sol.Select {
+		elems[i] = Number(v)
+	}
+	selectArr := NewArrayWithValues(elems)
+
+	result := NewMap()
+	result.Values["numItems"] = Number(sol.NumItems)
+	result.Values["select"] = selectArr
+	result.Values["objective"] = Number(sol.Objective)
+	result.Values["penalty"] = Number(sol.Penalty)
+	result.Values["total"] = Number(sol.Total)
+	result.Values["backend"] = Str(sol.Backend)
+	if r := sol.Reduction; r != nil {
+		red := NewMap()
+		red.Values["items"] = Number(r.Items)
+		red.Values["kept"] = Number(r.Kept)
+		red.Values["oversize"] = Number(r.Oversize)
+		red.Values["noValue"] = Number(r.NoValue)
+		red.Values["dominated"] = Number(r.Dominated)
+		red.Values["ms"] = Number(float64(r.Elapsed) / float64(time.Millisecond))
+		red.Values["cached"] = Bool(r.Cached)
+		result.Values["reduction"] = red
+	}
+	if b := sol.Bound; b != nil {
+		bound := NewMap()
+		bound.Values["upper"] = Number(b.Upper)
+		bound.Values["gap"] = Number(b.Gap)
+		bound.Values["optimal"] = Bool(b.Optimal)
+		result.Values["bound"] = bound
+	}
+	if st := sol.Stats; st != nil {
+		ms := func(d time.Duration) Value { return Number(float64(d) / float64(time.Millisecond)) }
+		stats := NewMap()
+		stats.Values["wallMs"] = ms(st.Wall)
+		stats.Values["encodeMs"] = ms(st.Encode)
+		stats.Values["reduceMs"] = ms(st.Reduce)
+		stats.Values["nativeMs"] = ms(st.Native)
+		stats.Values["decodeMs"] = ms(st.Decode)
+		stats.Values["refineMs"] = ms(st.Refine)
+		stats.Values["solves"] = Number(st.Solves)
+		stats.Values["items"] = Number(st.Items)
+		stats.Values["pruned"] = Number(st.Pruned)
+		stats.Values["selected"] = Number(st.Selected)
+		stats.Values["peakRSS"] = Number(st.PeakRSS)
+		stats.Values["backend"] = Str(st.Backend)
+		result.Values["stats"] = stats
+	}
+	return result
+}
+
+// knapsackPreparedArg unwraps a knapsackPrepare handle argument.
+func knapsackPreparedArg(fn string, arg Value) (*KnapsackPrepared, error) {
+	if tvar, ok := arg.(ScopeEntry); ok {
+		arg = tvar.Value
+	}
+	prepared, ok := arg.(*KnapsackPrepared)
+	if !ok {
+		return nil, fmt.Errorf("%s arg 0 (handle) must be handle from knapsackPrepare, got %T", fn, arg)
+	}
+	return prepared, nil
+}
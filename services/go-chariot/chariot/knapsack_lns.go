@@ -0,0 +1,263 @@
+package chariot
+
+import (
+	"context"
+	"encoding/json"
+	"math"
+	"math/rand"
+	"runtime"
+	"sort"
+	"time"
+)
+
+// Large-neighborhood search refines a solution after the main solve. Each
+// step picks a window of items inside one block, destroys part of the
+// selection there and greedily repairs it in a perturbed density order.
+// Moves are scored by delta on the per-constraint usage (see warmSearch),
+// so a step costs O(window x constraints) rather than a full evaluation.
+// Workers run steps from the same incumbent in parallel; after each round
+// the best improvement becomes the new incumbent.
+const (
+	lnsWindow     = 4096 // most items one neighborhood covers
+	lnsDestroy    = 0.3  // fraction of the window's selected items removed
+	lnsNoise      = 0.2  // relative noise on repair densities
+	lnsRoundSteps = 32   // steps per worker between incumbent exchanges
+	lnsMaxWorkers = 8
+
+	// Each extra worker of a threads portfolio visits about this many
+	// items, in 8 to 256 steps.
+	lnsPortfolioWork = 1 << 18
+)
+
+// lnsBlock is an item range from the config's blocks section.
+type lnsBlock struct {
+	start, count int
+}
+
+// lnsBlocks returns the config's blocks, or one block of all items when it
+// has none usable.
+func (p *KnapsackPrepared) lnsBlocks(n int) []lnsBlock {
+	var blocks []lnsBlock
+	if raw, ok := p.section("blocks"); ok {
+		var decoded []struct {
+			Start int `json:"start"`
+			Count int `json:"count"`
+		}
+		json.Unmarshal(raw, &decoded)
+		for _, b := range decoded {
+			if b.Count > 0 && b.Start >= 0 && b.Start+b.Count <= n {
+				blocks = append(blocks, lnsBlock{b.Start, b.Count})
+			}
+		}
+	}
+	if len(blocks) == 0 {
+		blocks = []lnsBlock{{0, n}}
+	}
+	return blocks
+}
+
+// refineLNS improves sol in place until deadline or until ctx is done,
+// recording the time spent in its timing. It starts with SolveWarm's
+// greedy fill and swaps, which stop at the deadline too. A solution
+// violating a hard constraint is repaired first and replaced by the
+// feasible result, if repair finishes. improved, if not nil, is passed a
+// copy of sol each time the search finds a better feasible solution.
+func (p *KnapsackPrepared) refineLNS(ctx context.Context, ed *knapsackEvalData, sol *V2Solution, deadline time.Time, seed int64, improved func(*V2Solution)) {
+	start := time.Now()
+	defer func() { sol.timing.refine += time.Since(start) }()
+	n := ed.numItems
+	if n == 0 || len(sol.Mask) != (n+63)/64 || len(sol.Select) != n {
+		return
+	}
+	blocks := p.lnsBlocks(n)
+
+	best := newWarmSearch(ed, append(SelectMask(nil), sol.Mask...))
+	best.deadline = deadline
+	feasible := best.feasible(best.use)
+	if !feasible {
+		best.repair()
+	}
+	best.improve()
+	// Each improvement is adopted as it is found, so improved sees sol as
+	// it stands and later adoptions compare against it.
+	report := func() {
+		if improved != nil && adoptLNS(ed, sol, best, feasible) {
+			feasible = true
+			improved(sol.into(new(V2Solution)))
+		}
+	}
+	report()
+	workers := runtime.GOMAXPROCS(0)
+	if workers > lnsMaxWorkers {
+		workers = lnsMaxWorkers
+	}
+	searches := make([]*lnsSearch, workers)
+	for w := range searches {
+		searches[w] = &lnsSearch{rng: rand.New(rand.NewSource(seed + int64(w)))}
+	}
+
+	for time.Now().Before(deadline) && ctx.Err() == nil {
+		runKnapsackPool(workers, workers, func(w int) {
+			s := searches[w]
+			s.reset(best)
+			for k := 0; k < lnsRoundSteps && time.Now().Before(deadline); k++ {
+				s.step(blocks)
+			}
+		})
+		winner := -1
+		for w, s := range searches {
+			if s.ws.total() > best.total()+warmEpsilon(best.total()) && (winner < 0 || s.ws.total() > searches[winner].ws.total()) {
+				winner = w
+			}
+		}
+		if winner >= 0 {
+			best = searches[winner].ws.clone()
+			report()
+		}
+	}
+
+	adoptLNS(ed, sol, best, feasible)
+}
+
+// refinePortfolio improves sol in place by the extra workers of a threads
+// portfolio (see SolveKnapsackParallel): after SolveWarm's greedy fill and
+// swaps, each worker runs a fixed number of steps from that solution (see
+// lnsPortfolioWork), worker w seeded with seed+w+1. There is no deadline, so the result depends only
+// on the inputs; the best total wins, ties going to the lowest worker.
+func (p *KnapsackPrepared) refinePortfolio(ed *knapsackEvalData, sol *V2Solution, workers int, seed int64) {
+	start := time.Now()
+	defer func() { sol.timing.refine += time.Since(start) }()
+	n := ed.numItems
+	if n == 0 || len(sol.Mask) != (n+63)/64 || len(sol.Select) != n {
+		return
+	}
+	blocks := p.lnsBlocks(n)
+	window := 0
+	for _, b := range blocks {
+		window = max(window, min(b.count, lnsWindow))
+	}
+	steps := min(max(lnsPortfolioWork/window, 8), 256)
+
+	base := newWarmSearch(ed, append(SelectMask(nil), sol.Mask...))
+	feasible := base.feasible(base.use)
+	if !feasible {
+		base.repair()
+	}
+	base.improve()
+	searches := make([]*lnsSearch, workers)
+	runKnapsackPool(workers, workers, func(w int) {
+		s := &lnsSearch{rng: rand.New(rand.NewSource(seed + int64(w) + 1))}
+		s.reset(base)
+		for k := 0; k < steps; k++ {
+			s.step(blocks)
+		}
+		searches[w] = s
+	})
+	best := base
+	for _, s := range searches {
+		if s.ws.total() > best.total()+warmEpsilon(best.total()) {
+			best = s.ws
+		}
+	}
+	adoptLNS(ed, sol, best, feasible)
+}
+
+// adoptLNS writes best into sol when it is feasible and either improves on
+// sol or replaces an infeasible sol (feasible reports which). It reports
+// whether sol changed.
+func adoptLNS(ed *knapsackEvalData, sol *V2Solution, best *warmSearch, feasible bool) bool {
+	ev := ed.evaluate(best.sel)
+	if !ev.Feasible || (feasible && ev.Total <= sol.Total) {
+		return false
+	}
+	copy(sol.Mask, best.sel)
+	for i := range sol.Select {
+		sol.Select[i] = 0
+		if best.sel.Has(i) {
+			sol.Select[i] = 1
+		}
+	}
+	sol.Objective, sol.Penalty, sol.Total = ev.Objective, ev.Penalty, ev.Total
+	return true
+}
+
+// lnsSearch is one worker's state.
+type lnsSearch struct {
+	ws      *warmSearch
+	rng     *rand.Rand
+	journal []int // items toggled by the current step
+	cands   []lnsCand
+}
+
+type lnsCand struct {
+	item    int
+	density float64
+}
+
+// reset copies the incumbent into the worker, reusing its buffers.
+func (s *lnsSearch) reset(from *warmSearch) {
+	if s.ws == nil {
+		s.ws = from.clone()
+		return
+	}
+	copy(s.ws.sel, from.sel)
+	copy(s.ws.use, from.use)
+	s.ws.obj = from.obj
+}
+
+// step destroys and repairs one window, keeping the result unless it
+// lowers the total.
+func (s *lnsSearch) step(blocks []lnsBlock) {
+	ws := s.ws
+	b := blocks[s.rng.Intn(len(blocks))]
+	lo, hi := b.start, b.start+b.count
+	if b.count > lnsWindow {
+		lo += s.rng.Intn(b.count - lnsWindow + 1)
+		hi = lo + lnsWindow
+	}
+	before := ws.total()
+	s.journal = s.journal[:0]
+
+	for i := lo; i < hi; i++ {
+		if ws.sel.Has(i) && s.rng.Float64() < lnsDestroy {
+			s.flip(i)
+			s.journal = append(s.journal, i)
+		}
+	}
+
+	s.cands = s.cands[:0]
+	for j := lo; j < hi; j++ {
+		if ws.sel.Has(j) || ws.ed.objective[j] <= 0 {
+			continue
+		}
+		d := math.Inf(1)
+		if ws.size[j] > 0 {
+			d = ws.ed.objective[j] / ws.size[j] * (1 + lnsNoise*s.rng.Float64())
+		}
+		s.cands = append(s.cands, lnsCand{j, d})
+	}
+	sort.Slice(s.cands, func(a, b int) bool { return s.cands[a].density > s.cands[b].density })
+	for _, c := range s.cands {
+		if gain, ok := ws.tryMove(c.item, -1); ok && gain > warmEpsilon(ws.obj) {
+			ws.apply(c.item, -1)
+			s.journal = append(s.journal, c.item)
+		}
+	}
+
+	if ws.total() < before-warmEpsilon(before) {
+		for k := len(s.journal) - 1; k >= 0; k-- {
+			s.flip(s.journal[k])
+		}
+	}
+}
+
+// flip selects or deselects item i.
+func (s *lnsSearch) flip(i int) {
+	if s.ws.sel.Has(i) {
+		s.ws.tryMove(-1, i)
+		s.ws.apply(-1, i)
+	} else {
+		s.ws.tryMove(i, -1)
+		s.ws.apply(i, -1)
+	}
+}
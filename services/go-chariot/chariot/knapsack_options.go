@@ -0,0 +1,221 @@
+package chariot
+
+import (
+	"encoding/json"
+	"fmt"
+	"math"
+	"sort"
+	"strconv"
+	"time"
+)
+
+// KnapsackOptions is the typed form of the solver options JSON accepted by
+// knapsack() and the Solve* functions. ParseKnapsackOptions decodes the JSON
+// once; every solve layer then reads fields instead of re-scanning it, and
+// the library options are rendered once per library call.
+type KnapsackOptions struct {
+	// Passed to the solver library.
+	BeamWidth int             // beam_width; 0 = library default
+	Iters     int             // iters; 0 = library default
+	Seed      int64           // seed; sent when non-zero or given in the JSON
+	DomEnable json.RawMessage // dom_enable as the caller wrote it; nil = library default
+	// Native holds any other options (debug, ...), passed through unchanged.
+	Native map[string]json.RawMessage
+
+	// Applied in Go.
+	Threads    int           // portfolio size (see SolveKnapsackParallel); 0 = single solve
+	TimeBudget time.Duration // time_budget_ms (see SolveKnapsackAnytime); 0 = none
+	Backend    string        // "", "auto", "cpu", "cuda" or "metal" (see checkKnapsackBackend)
+	Stats      bool          // fill V2Solution.Stats
+	Reduce     bool          // item reduction (see SolvePrepared)
+	Engine     string        // "", "beam", "exact" or "auto" (see solveEngine)
+	LNS        time.Duration // lns_ms refinement budget (see refineLNS)
+
+	seedSet bool
+}
+
+// ParseKnapsackOptions decodes optionsJSON ("" means none) and validates it.
+func ParseKnapsackOptions(optionsJSON string) (*KnapsackOptions, error) {
+	return parseKnapsackOptions("SolveKnapsack", optionsJSON)
+}
+
+func parseKnapsackOptions(fn string, optionsJSON string) (*KnapsackOptions, error) {
+	o := &KnapsackOptions{}
+	if optionsJSON == "" {
+		return o, nil
+	}
+	var raw map[string]json.RawMessage
+	if err := json.Unmarshal([]byte(optionsJSON), &raw); err != nil {
+		return nil, fmt.Errorf("%s: invalid options JSON: %w", fn, err)
+	}
+
+	integer := func(key string, dst *int) error {
+		var v float64
+		if err := json.Unmarshal(raw[key], &v); err != nil || v != math.Trunc(v) || v < 0 || v > math.MaxInt32 {
+			return fmt.Errorf("%s: %s must be a non-negative integer", fn, key)
+		}
+		*dst = int(v)
+		return nil
+	}
+	millis := func(key string, dst *time.Duration, what string) error {
+		var ms float64
+		if err := json.Unmarshal(raw[key], &ms); err != nil || ms < 0 || (what == "positive" && ms == 0) {
+			return fmt.Errorf("%s: %s must be a %s number", fn, key, what)
+		}
+		*dst = time.Duration(ms * float64(time.Millisecond))
+		return nil
+	}
+	boolean := func(key string, dst *bool) error {
+		if err := json.Unmarshal(raw[key], dst); err != nil {
+			return fmt.Errorf("%s: %s must be a boolean", fn, key)
+		}
+		return nil
+	}
+	str := func(key string, dst *string) error {
+		if err := json.Unmarshal(raw[key], dst); err != nil {
+			return fmt.Errorf("%s: %s must be a string", fn, key)
+		}
+		return nil
+	}
+
+	for key := range raw {
+		var err error
+		switch key {
+		case "beam_width":
+			err = integer(key, &o.BeamWidth)
+		case "iters":
+			err = integer(key, &o.Iters)
+		case "seed":
+			if json.Unmarshal(raw[key], &o.Seed) != nil {
+				err = fmt.Errorf("%s: seed must be an integer", fn)
+			}
+			o.seedSet = true
+		case "dom_enable":
+			// The library reads the value itself: `1` is not `true` to it.
+			o.DomEnable = raw[key]
+		case "threads":
+			var v float64
+			if json.Unmarshal(raw[key], &v) != nil || v != math.Trunc(v) || v < 1 || v > maxKnapsackThreads {
+				err = fmt.Errorf("%s: threads must be an integer 1-%d", fn, maxKnapsackThreads)
+			}
+			o.Threads = int(v)
+		case "time_budget_ms":
+			err = millis(key, &o.TimeBudget, "positive")
+		case "lns_ms":
+			err = millis(key, &o.LNS, "non-negative")
+		case "backend":
+			err = str(key, &o.Backend)
+		case "engine":
+			err = str(key, &o.Engine)
+		case "stats":
+			err = boolean(key, &o.Stats)
+		case "reduce":
+			err = boolean(key, &o.Reduce)
+		default:
+			if o.Native == nil {
+				o.Native = map[string]json.RawMessage{}
+			}
+			o.Native[key] = raw[key]
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+	if err := o.validate(fn); err != nil {
+		return nil, err
+	}
+	return o, nil
+}
+
+// validate checks the enumerated and bounded fields, for options built in
+// Go as well as parsed ones.
+func (o *KnapsackOptions) validate(fn string) error {
+	switch o.Backend {
+	case "", "auto", "cpu", "cuda", "metal":
+	default:
+		return fmt.Errorf("%s: unknown backend %q (want auto, cpu, cuda or metal)", fn, o.Backend)
+	}
+	switch o.Engine {
+	case "", knapsackEngineBeam, knapsackEngineExact, knapsackEngineAuto:
+	default:
+		return fmt.Errorf(`%s: engine must be "beam", "exact" or "auto"`, fn)
+	}
+	if o.Threads < 0 || o.Threads > maxKnapsackThreads {
+		return fmt.Errorf("%s: threads must be an integer 1-%d", fn, maxKnapsackThreads)
+	}
+	if o.BeamWidth < 0 || o.Iters < 0 || o.TimeBudget < 0 || o.LNS < 0 {
+		return fmt.Errorf("%s: beam_width, iters, time_budget_ms and lns_ms must not be negative", fn)
+	}
+	return nil
+}
+
+// needsBound reports whether a prepared solve with o uses the column view
+// and its LP bound: to pick an engine, to stop a time budget at the bound,
+// to refine, or to report the bound in a reduced or stats solve.
+func (o *KnapsackOptions) needsBound() bool {
+	return (o.Engine != "" && o.Engine != knapsackEngineBeam) || o.TimeBudget > 0 || o.LNS > 0 || o.Threads > 1 || o.Reduce || o.Stats
+}
+
+// libraryOptions returns o with the Go-side options cleared, as passed
+// below the prepared layer.
+func (o *KnapsackOptions) libraryOptions() *KnapsackOptions {
+	lib := *o
+	lib.Stats, lib.Reduce, lib.Engine, lib.LNS = false, false, "", 0
+	return &lib
+}
+
+// libraryJSON renders the options the solver library reads, with keys in
+// a fixed order. "" means none.
+func (o *KnapsackOptions) libraryJSON() string {
+	if o.BeamWidth == 0 && o.Iters == 0 && o.Seed == 0 && !o.seedSet && o.DomEnable == nil && len(o.Native) == 0 {
+		return ""
+	}
+	buf := make([]byte, 0, 64)
+	field := func(key string) {
+		if len(buf) > 0 {
+			buf = append(buf, ',')
+		} else {
+			buf = append(buf, '{')
+		}
+		buf = strconv.AppendQuote(buf, key)
+		buf = append(buf, ':')
+	}
+	if o.BeamWidth != 0 {
+		field("beam_width")
+		buf = strconv.AppendInt(buf, int64(o.BeamWidth), 10)
+	}
+	if o.Iters != 0 {
+		field("iters")
+		buf = strconv.AppendInt(buf, int64(o.Iters), 10)
+	}
+	if o.Seed != 0 || o.seedSet {
+		field("seed")
+		buf = strconv.AppendInt(buf, o.Seed, 10)
+	}
+	if o.DomEnable != nil {
+		field("dom_enable")
+		buf = append(buf, o.DomEnable...)
+	}
+	keys := make([]string, 0, len(o.Native))
+	for k := range o.Native {
+		keys = append(keys, k)
+	}
+	sort.Strings(keys)
+	for _, k := range keys {
+		field(k)
+		buf = append(buf, o.Native[k]...)
+	}
+	return string(append(buf, '}'))
+}
+
+// SolveKnapsackWith solves configJSON as knapsack() does, applying every
+// Go-side option, with options already in typed form. opts may be nil. The
+// solution is written into dst when it is not nil (see SolveKnapsackInto).
+func SolveKnapsackWith(configJSON string, opts *KnapsackOptions, dst *V2Solution) (*V2Solution, error) {
+	if opts == nil {
+		opts = &KnapsackOptions{}
+	} else if err := opts.validate("SolveKnapsack"); err != nil {
+		return nil, err
+	}
+	return solveKnapsackOptionsInto(configJSON, opts, dst)
+}
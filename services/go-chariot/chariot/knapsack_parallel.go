@@ -0,0 +1,92 @@
+package chariot
+
+import (
+	"runtime"
+	"sync"
+	"sync/atomic"
+)
+
+// maxKnapsackThreads bounds the portfolio size accepted in the threads option.
+const maxKnapsackThreads = 256
+
+// SolveKnapsackParallel solves a V2 config honoring the Go-side "threads"
+// solver option. Without it (or with threads=1) this is SolveKnapsack.
+//
+// The solver library's result does not depend on seed, beam_width or
+// iters, so repeated library solves would all return the same selection.
+// threads=N instead solves once and spends the other N-1 workers on
+// independent seeded destroy/repair refinements of that solution (see
+// refinePortfolio), on min(N-1, GOMAXPROCS) goroutines. The result depends
+// only on the config, options and N, never on scheduling, and its total is
+// never below the single solve's unless that solve violated a hard
+// constraint and was repaired. Configs the Go side cannot decode (see
+// EvaluateSelect), or with constraints other than capacity constraints
+// (see capacityOnly), get the single solve.
+func SolveKnapsackParallel(configJSON string, optionsJSON string) (*V2Solution, error) {
+	opts, err := parseKnapsackOptions("SolveKnapsackParallel", optionsJSON)
+	if err != nil {
+		return nil, err
+	}
+	return solveKnapsackParallel(configJSON, knapsackBackendFor(configJSON), opts, nil)
+}
+
+// solveKnapsackParallel is SolveKnapsackParallel with parsed options and
+// the backend the library uses for configJSON, writing into dst when it is
+// not nil.
+func solveKnapsackParallel(configJSON string, backend string, opts *KnapsackOptions, dst *V2Solution) (*V2Solution, error) {
+	if dst == nil {
+		dst = new(V2Solution)
+	}
+	if err := solveKnapsackInto(configJSON, opts.libraryJSON(), backend, dst); err != nil {
+		return nil, err
+	}
+	if opts.Threads <= 1 {
+		return dst, nil
+	}
+	p, err := PrepareKnapsack(configJSON)
+	if err != nil {
+		return dst, nil
+	}
+	defer p.Release()
+	ed, err := p.evalColumnsWith("SolveKnapsackParallel", &KnapsackOverrides{})
+	if err != nil || !capacityOnly(p, ed) {
+		return dst, nil
+	}
+	p.refinePortfolio(ed, dst, opts.Threads-1, opts.Seed)
+	return dst, nil
+}
+
+// runKnapsackPool calls fn(0..n-1) on at most min(workers, GOMAXPROCS)
+// goroutines. Workers claim indices from a shared counter, so a slow solve
+// does not hold up the rest of the queue.
+func runKnapsackPool(n int, workers int, fn func(i int)) {
+	if p := runtime.GOMAXPROCS(0); workers > p {
+		workers = p
+	}
+	if workers > n {
+		workers = n
+	}
+	if workers <= 1 {
+		for i := 0; i < n; i++ {
+			fn(i)
+		}
+		return
+	}
+
+	var next int64 = -1
+	var wg sync.WaitGroup
+	for w := 0; w < workers; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for {
+				i := int(atomic.AddInt64(&next, 1))
+				if i >= n {
+					return
+				}
+				fn(i)
+			}
+		}()
+	}
+	wg.Wait()
+}
@@ -0,0 +1,463 @@
+package chariot
+
+import (
+	"bytes"
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"math"
+	"os"
+	"runtime"
+	"sync"
+	"time"
+	"unsafe"
+)
+
+// KnapsackPrepared keeps a parsed V2 knapsack config resident between solves.
+//
+// The config is split into its top-level sections once. Sections are kept as
+// raw JSON, so the (typically large) items payload is never re-marshaled;
+// only the objective and constraint sections are decoded, because those are
+// what per-solve overrides patch.
+type KnapsackPrepared struct {
+	sections    []preparedSection
+	objective   []map[string]interface{}
+	constraints []map[string]interface{}
+	numItems    int
+	backend     string              // backend the library runs the config on (see knapsackBackendOf)
+	config      []byte              // encoded config with no overrides applied
+	columnFile  *KnapsackColumnFile // mapped attribute columns, if any
+	staged      []string            // attribute column files owned by this handle
+	ownedFile   *os.File            // writable handle on staged[0] once ApplyDelta has run
+	released    bool
+
+	// mutMu is held for reading by solves and evaluations and for writing
+	// by ApplyDelta, BindRLScores, RL rescoring and Release, which change
+	// or unmap the columns a running solve reads.
+	mutMu sync.RWMutex
+
+	evalMu   sync.Mutex
+	eval     *knapsackEvalData    // column view for EvaluateSelect, built on first use
+	evalCols map[string][]float64 // decoded attribute columns shared by column views
+
+	reduceMu sync.Mutex
+	reduced  *preparedReduction // last reduction computed for the "reduce" option
+
+	rlMu sync.Mutex
+	rl   *knapsackRLBinding // RL-scored attribute, see BindRLScores
+}
+
+// preparedSection is one top-level key of the config in original order.
+type preparedSection struct {
+	key string
+	raw json.RawMessage
+}
+
+// KnapsackOverrides patches a prepared config for a single solve.
+// Limits are keyed by constraint attr, weights by objective attr.
+type KnapsackOverrides struct {
+	Limits  map[string]float64 `json:"limits,omitempty"`
+	Weights map[string]float64 `json:"weights,omitempty"`
+}
+
+// PrepareKnapsack parses and validates a V2 config once so it can be solved
+// repeatedly with SolvePrepared.
+func PrepareKnapsack(configJSON string) (*KnapsackPrepared, error) {
+	if configJSON == "" {
+		return nil, errors.New("PrepareKnapsack: empty V2 config JSON")
+	}
+
+	dec := json.NewDecoder(bytes.NewReader([]byte(configJSON)))
+	tok, err := dec.Token()
+	if err != nil {
+		return nil, fmt.Errorf("PrepareKnapsack: invalid JSON: %w", err)
+	}
+	if delim, ok := tok.(json.Delim); !ok || delim != '{' {
+		return nil, errors.New("PrepareKnapsack: config must be a JSON object")
+	}
+
+	p := &KnapsackPrepared{}
+	var mode string
+	for dec.More() {
+		keyTok, err := dec.Token()
+		if err != nil {
+			return nil, fmt.Errorf("PrepareKnapsack: invalid JSON: %w", err)
+		}
+		key := keyTok.(string)
+		var raw json.RawMessage
+		if err := dec.Decode(&raw); err != nil {
+			return nil, fmt.Errorf("PrepareKnapsack: invalid JSON in %q: %w", key, err)
+		}
+		p.sections = append(p.sections, preparedSection{key: key, raw: raw})
+
+		switch key {
+		case "items":
+			var items struct {
+				Count int `json:"count"`
+			}
+			if err := json.Unmarshal(raw, &items); err != nil {
+				return nil, fmt.Errorf("PrepareKnapsack: invalid items: %w", err)
+			}
+			p.numItems = items.Count
+		case "mode":
+			// A mode the library rejects fails the solve, not the prepare;
+			// a mode that is not a string keeps its raw text here.
+			if json.Unmarshal(raw, &mode) != nil {
+				mode = string(raw)
+			}
+		case "objective":
+			if err := json.Unmarshal(raw, &p.objective); err != nil {
+				return nil, fmt.Errorf("PrepareKnapsack: objective must be an array of objects: %w", err)
+			}
+		case "constraints":
+			if err := json.Unmarshal(raw, &p.constraints); err != nil {
+				return nil, fmt.Errorf("PrepareKnapsack: constraints must be an array of objects: %w", err)
+			}
+		}
+	}
+
+	if p.numItems <= 0 {
+		return nil, errors.New("PrepareKnapsack: items.count must be > 0")
+	}
+	if len(p.objective) == 0 {
+		return nil, errors.New("PrepareKnapsack: objective must have at least one term")
+	}
+
+	p.backend = knapsackBackendOf(mode, p.constraints)
+	p.config = []byte(configJSON)
+	runtime.SetFinalizer(p, (*KnapsackPrepared).Release)
+	return p, nil
+}
+
+// NumItems returns the item count of the prepared problem.
+func (p *KnapsackPrepared) NumItems() int {
+	return p.numItems
+}
+
+// Release drops the resident config, unmaps any column file and removes
+// staged attribute columns. It waits for running solves; further solves
+// return an error.
+func (p *KnapsackPrepared) Release() {
+	p.mutMu.Lock()
+	defer p.mutMu.Unlock()
+	p.dropReduction()
+	p.evalMu.Lock()
+	defer p.evalMu.Unlock()
+	p.eval = nil
+	p.evalCols = nil
+	if p.ownedFile != nil {
+		p.ownedFile.Close()
+		p.ownedFile = nil
+	}
+	if p.columnFile != nil {
+		p.columnFile.Close()
+		p.columnFile = nil
+	}
+	for _, path := range p.staged {
+		os.Remove(path)
+	}
+	p.staged = nil
+	p.sections = nil
+	p.objective = nil
+	p.constraints = nil
+	p.config = nil
+	p.released = true
+}
+
+// SolvePrepared solves the prepared problem with optional overrides
+// (see KnapsackOverrides) and solver options.
+//
+// The Go-side option "reduce": true first removes items no optimal solution
+// needs (see reduceItems) and solves the smaller problem; the selection is
+// mapped back to the full item numbering and Reduction reports what was
+// removed. The reduced problem is kept on the handle, so later solves with
+// the same overrides skip the reduction.
+//
+// The option "engine" picks the solver: "beam" (default), "exact" or "auto"
+// (see solveEngine). Capacity-only problems report an LP upper bound in
+// Bound when an option needs it (see needsBound), and anytime solves
+// (time_budget_ms) stop once it is reached. A plain beam solve computes no
+// bound.
+// "lns_ms" then spends up to that many milliseconds refining the solution
+// by large-neighborhood search (see refineLNS).
+//
+// Solves and evaluations on one handle may run concurrently; ApplyDelta
+// and Release wait for them to finish. With RL scores bound (see
+// BindRLScores), a solve first rescores what the RL model's learning made
+// stale, waiting for running solves to finish while it writes; a Learn
+// from another goroutine after that shows in the next solve.
+func (p *KnapsackPrepared) SolvePrepared(overridesJSON string, optionsJSON string) (*V2Solution, error) {
+	return p.solvePreparedJSON(overridesJSON, optionsJSON, nil)
+}
+
+// SolvePreparedInto is SolvePrepared writing the solution into dst. Its
+// Select and Mask storage is reused when large enough, so a loop that
+// re-solves into the same V2Solution does not reallocate them; slices taken
+// from dst earlier are overwritten. dst is left untouched on error.
+func (p *KnapsackPrepared) SolvePreparedInto(overridesJSON string, optionsJSON string, dst *V2Solution) error {
+	if dst == nil {
+		return errors.New("SolvePrepared: nil destination")
+	}
+	_, err := p.solvePreparedJSON(overridesJSON, optionsJSON, dst)
+	return err
+}
+
+// SolvePreparedWith is SolvePrepared with typed overrides and options, so a
+// solve loop parses neither. Either may be nil. The solution is written
+// into dst when it is not nil (see SolvePreparedInto).
+func (p *KnapsackPrepared) SolvePreparedWith(ov *KnapsackOverrides, opts *KnapsackOptions, dst *V2Solution) (*V2Solution, error) {
+	if ov == nil {
+		ov = &KnapsackOverrides{}
+	}
+	if opts == nil {
+		opts = &KnapsackOptions{}
+	} else if err := opts.validate("SolvePrepared"); err != nil {
+		return nil, err
+	}
+	return p.solvePrepared(ov, opts, dst)
+}
+
+func (p *KnapsackPrepared) solvePreparedJSON(overridesJSON string, optionsJSON string, dst *V2Solution) (*V2Solution, error) {
+	ov, err := parseKnapsackOverrides("SolvePrepared", overridesJSON)
+	if err != nil {
+		return nil, err
+	}
+	opts, err := parseKnapsackOptions("SolvePrepared", optionsJSON)
+	if err != nil {
+		return nil, err
+	}
+	return p.solvePrepared(ov, opts, dst)
+}
+
+// solvePrepared is SolvePrepared with parsed arguments, writing into dst
+// when it is not nil.
+func (p *KnapsackPrepared) solvePrepared(ov *KnapsackOverrides, opts *KnapsackOptions, dst *V2Solution) (*V2Solution, error) {
+	if err := p.refreshRLScores("SolvePrepared"); err != nil {
+		return nil, err
+	}
+	p.mutMu.RLock()
+	defer p.mutMu.RUnlock()
+	if p.released {
+		return nil, errors.New("SolvePrepared: prepared problem has been released")
+	}
+	if cf := p.columnFile; cf != nil {
+		if err := cf.checkCurrent(); err != nil {
+			return nil, fmt.Errorf("SolvePrepared: %w", err)
+		}
+	}
+	// Layers below see only the options they apply.
+	lib := opts.libraryOptions()
+
+	start := time.Now()
+	upper := math.Inf(1)
+	// The column view and its bound cost a decode and a sort, so a plain
+	// beam solve goes without them.
+	var ed *knapsackEvalData
+	var edErr error
+	if opts.needsBound() {
+		if ed, edErr = p.evalColumnsWith("SolvePrepared", ov); edErr == nil {
+			if b, ok := ed.upperBound(p); ok {
+				upper = b
+			}
+			// The threads portfolio refines on the full problem's columns.
+			lib.Threads = 0
+		}
+	}
+
+	var sol *V2Solution
+	var err error
+	if opts.Engine == knapsackEngineExact && edErr != nil {
+		return nil, edErr
+	}
+	if ed != nil {
+		if sol, err = p.solveEngine(opts.Engine, ed, upper); err != nil {
+			return nil, err
+		}
+	}
+	switch {
+	case sol != nil:
+		sol = sol.into(dst)
+	case opts.Reduce:
+		sol, err = p.solveReduced(ov, lib, upper, dst)
+	default:
+		sol, err = solveEncoded(p, ed, ov, lib, upper, dst)
+	}
+	if err != nil {
+		return nil, err
+	}
+	// The refinements score only capacity constraints (see capacityOnly),
+	// so other problems keep the solution they have.
+	refine := ed != nil && sol.Bound == nil && capacityOnly(p, ed)
+	if opts.Threads > 1 && refine && !gapClosed(upper, sol.Total) {
+		p.refinePortfolio(ed, sol, opts.Threads-1, opts.Seed)
+	}
+	if opts.LNS > 0 && refine && !gapClosed(upper, sol.Total) {
+		p.refineLNS(context.Background(), ed, sol, time.Now().Add(opts.LNS), opts.Seed, nil)
+	}
+	if sol.Bound == nil && !math.IsInf(upper, 1) {
+		sol.withBound(upper, false)
+	}
+	if opts.Stats {
+		sol.setStats(time.Since(start))
+	}
+	return sol, nil
+}
+
+// solveEncoded encodes target (p or its reduced child) with ov and solves
+// it into dst (nil for a new solution), recording the encode time. Anytime
+// solves refine on target's column view ed (nil to build it when needed),
+// and a finite upper ends them early.
+func solveEncoded(target *KnapsackPrepared, ed *knapsackEvalData, ov *KnapsackOverrides, opts *KnapsackOptions, upper float64, dst *V2Solution) (*V2Solution, error) {
+	start := time.Now()
+	cfg, err := target.encode(ov)
+	if err != nil {
+		return nil, err
+	}
+	encode := time.Since(start)
+	// The encoded config is never modified (ApplyDelta builds a new one),
+	// so it is viewed as a string rather than copied.
+	cfgJSON := unsafe.String(unsafe.SliceData(cfg), len(cfg))
+	var sol *V2Solution
+	if opts.TimeBudget > 0 {
+		if sol, err = solveToBound(cfgJSON, target.backend, opts, upper, target.anytimeRefiner(ov, ed, opts.Seed)); err == nil {
+			sol = sol.into(dst)
+		}
+	} else {
+		sol, err = solveKnapsackBackend(cfgJSON, target.backend, opts, dst)
+	}
+	if err != nil {
+		return nil, err
+	}
+	sol.timing.encode += encode
+	return sol, nil
+}
+
+// joinSections renders the sections as a config with no overrides applied.
+func (p *KnapsackPrepared) joinSections() []byte {
+	var buf bytes.Buffer
+	buf.Grow(len(p.config) + 64)
+	buf.WriteByte('{')
+	for i, s := range p.sections {
+		if i > 0 {
+			buf.WriteByte(',')
+		}
+		key, _ := json.Marshal(s.key)
+		buf.Write(key)
+		buf.WriteByte(':')
+		buf.Write(s.raw)
+	}
+	buf.WriteByte('}')
+	return buf.Bytes()
+}
+
+// parseKnapsackOverrides decodes an overrides JSON object; "" means none.
+func parseKnapsackOverrides(fn string, overridesJSON string) (*KnapsackOverrides, error) {
+	var ov KnapsackOverrides
+	if overridesJSON != "" {
+		if err := json.Unmarshal([]byte(overridesJSON), &ov); err != nil {
+			return nil, fmt.Errorf("%s: invalid overrides JSON: %w", fn, err)
+		}
+	}
+	return &ov, nil
+}
+
+// encode renders the config with overrides applied. Sections that no
+// override touches are copied through as raw bytes.
+func (p *KnapsackPrepared) encode(ov *KnapsackOverrides) ([]byte, error) {
+	if len(ov.Limits) == 0 && len(ov.Weights) == 0 {
+		return p.config, nil
+	}
+
+	objective, err := patchTerms(p.objective, "weight", ov.Weights)
+	if err != nil {
+		return nil, fmt.Errorf("SolvePrepared: objective override: %w", err)
+	}
+	constraints, err := patchTerms(p.constraints, "limit", ov.Limits)
+	if err != nil {
+		return nil, fmt.Errorf("SolvePrepared: constraint override: %w", err)
+	}
+
+	var buf bytes.Buffer
+	buf.Grow(len(p.config) + 64)
+	buf.WriteByte('{')
+	for i, s := range p.sections {
+		if i > 0 {
+			buf.WriteByte(',')
+		}
+		key, _ := json.Marshal(s.key)
+		buf.Write(key)
+		buf.WriteByte(':')
+
+		var patched interface{}
+		switch {
+		case s.key == "objective" && objective != nil:
+			patched = objective
+		case s.key == "constraints" && constraints != nil:
+			patched = constraints
+		}
+		if patched == nil {
+			buf.Write(s.raw)
+			continue
+		}
+		data, err := json.Marshal(patched)
+		if err != nil {
+			return nil, fmt.Errorf("SolvePrepared: failed to marshal %s: %w", s.key, err)
+		}
+		buf.Write(data)
+	}
+	buf.WriteByte('}')
+	return buf.Bytes(), nil
+}
+
+// patchTerms returns a copy of terms with field set from values, matched by
+// each term's "attr". Returns nil when values is empty. Every key in values
+// must match at least one term.
+func patchTerms(terms []map[string]interface{}, field string, values map[string]float64) ([]map[string]interface{}, error) {
+	if len(values) == 0 {
+		return nil, nil
+	}
+
+	matched := make(map[string]bool, len(values))
+	out := make([]map[string]interface{}, len(terms))
+	for i, term := range terms {
+		attr, _ := term["attr"].(string)
+		v, ok := values[attr]
+		if !ok {
+			out[i] = term
+			continue
+		}
+		cp := make(map[string]interface{}, len(term))
+		for k, tv := range term {
+			cp[k] = tv
+		}
+		cp[field] = v
+		out[i] = cp
+		matched[attr] = true
+	}
+
+	for attr := range values {
+		if !matched[attr] {
+			return nil, fmt.Errorf("no term with attr %q", attr)
+		}
+	}
+	return out, nil
+}
+
+// Type implements Value interface
+func (p *KnapsackPrepared) Type() string {
+	return "KnapsackPrepared"
+}
+
+// String implements Value interface
+func (p *KnapsackPrepared) String() string {
+	if p.released {
+		return "<KnapsackPrepared:released>"
+	}
+	return fmt.Sprintf("<KnapsackPrepared:%d items>", p.numItems)
+}
+
+// ToBool implements Value interface
+func (p *KnapsackPrepared) ToBool() bool {
+	return !p.released
+}
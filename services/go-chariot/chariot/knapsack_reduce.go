@@ -0,0 +1,332 @@
+package chariot
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"math"
+	"sort"
+	"time"
+)
+
+// KnapsackReduction reports the item reduction run before a prepared solve
+// with the "reduce" option (see SolvePrepared).
+type KnapsackReduction struct {
+	Items     int           // items in the prepared problem
+	Kept      int           // items passed to the solver
+	Oversize  int           // removed: larger than a hard limit on their own
+	NoValue   int           // removed: add no objective value
+	Dominated int           // removed: beaten by enough better, smaller items
+	Elapsed   time.Duration // time spent computing the reduction
+	Cached    bool          // reused from an earlier solve
+}
+
+// preparedReduction is a reduced problem cached on its parent handle.
+type preparedReduction struct {
+	key   string            // overrides the reduction was computed for
+	child *KnapsackPrepared // reduced problem; nil when no item was removed
+	index []int             // child item -> parent item
+	stats KnapsackReduction
+}
+
+// reduceChunk is the number of items scanned per pool task.
+const reduceChunk = 1 << 14
+
+// solveReduced solves the problem with provably useless items removed. The
+// reduction is cached on the handle per overrides; Release and ApplyDelta
+// drop it. Removing items keeps the optimum, so upper still bounds it.
+func (p *KnapsackPrepared) solveReduced(ov *KnapsackOverrides, opts *KnapsackOptions, upper float64, dst *V2Solution) (*V2Solution, error) {
+	key, _ := json.Marshal(ov)
+	r, err := p.reduction(ov, string(key))
+	if err != nil {
+		return nil, err
+	}
+
+	n := r.stats.Items
+	if dst == nil {
+		dst = new(V2Solution)
+	}
+	sol := dst
+	switch {
+	case r.stats.Kept == 0:
+		sol.reuse(n)
+		sol.Backend = "go"
+	case r.child == nil:
+		if sol, err = solveEncoded(p, nil, ov, opts, upper, dst); err != nil {
+			return nil, err
+		}
+	default:
+		reduced, err := solveEncoded(r.child, nil, ov, opts, upper, nil)
+		if err != nil {
+			return nil, err
+		}
+		sol.reuse(n)
+		sol.Objective = reduced.Objective
+		sol.Penalty = reduced.Penalty
+		sol.Total = reduced.Total
+		sol.Backend = reduced.Backend
+		sol.timing = reduced.timing
+		for i, v := range reduced.Select {
+			if v != 0 {
+				sol.Select[r.index[i]] = 1
+				sol.Mask.Set(r.index[i], true)
+			}
+		}
+	}
+	stats := r.stats
+	sol.Reduction = &stats
+	return sol, nil
+}
+
+// reduction returns the cached reduction for key, computing it if needed.
+func (p *KnapsackPrepared) reduction(ov *KnapsackOverrides, key string) (*preparedReduction, error) {
+	p.reduceMu.Lock()
+	defer p.reduceMu.Unlock()
+	if r := p.reduced; r != nil && r.key == key {
+		cached := *r
+		cached.stats.Cached = true
+		return &cached, nil
+	}
+
+	start := time.Now()
+	ed, err := p.evalColumnsWith("SolvePrepared", ov)
+	if err != nil {
+		return nil, err
+	}
+	removed, stats := reduceItems(p, ed)
+	r := &preparedReduction{key: key, stats: stats}
+	if stats.Kept > 0 && stats.Kept < stats.Items {
+		if r.child, r.index, err = p.reducedProblem(removed); err != nil {
+			return nil, err
+		}
+	}
+	r.stats.Elapsed = time.Since(start)
+
+	if p.reduced != nil && p.reduced.child != nil {
+		p.reduced.child.Release()
+	}
+	p.reduced = r
+	return r, nil
+}
+
+// dropReduction releases the cached reduction. Caller must not hold reduceMu.
+func (p *KnapsackPrepared) dropReduction() {
+	p.reduceMu.Lock()
+	defer p.reduceMu.Unlock()
+	if p.reduced != nil && p.reduced.child != nil {
+		p.reduced.child.Release()
+	}
+	p.reduced = nil
+}
+
+// reduceItems marks items that no optimal solution needs. It returns the
+// removed items in ascending order.
+//
+// The rules assume non-negative constraint columns and are skipped
+// otherwise, as are problems with constraints other than capacity:
+//   - an item using more of a hard limit than the limit itself never fits;
+//   - an item with objective value <= 0 never raises the total;
+//   - with one constraint, which is hard, an item is dominated when at least
+//     M other items have no less value and no larger size, where M is the
+//     most items any feasible selection can hold. Any selection using it
+//     leaves one of those out, and swapping that one in is no worse.
+//
+// The per-item rules run in parallel over chunks. The dominance pass sorts
+// once by size and once by value (concurrently) and sweeps with a Fenwick
+// tree, so it costs O(n log n) rather than comparing items pairwise.
+func reduceItems(p *KnapsackPrepared, ed *knapsackEvalData) ([]int, KnapsackReduction) {
+	n := ed.numItems
+	stats := KnapsackReduction{Items: n, Kept: n}
+	if !capacityOnly(p, ed) {
+		return nil, stats
+	}
+
+	// 0 = kept, 1 = oversize, 2 = no value, 3 = dominated.
+	reason := make([]uint8, n)
+	chunks := (n + reduceChunk - 1) / reduceChunk
+	runKnapsackPool(chunks, chunks, func(c int) {
+		end := (c + 1) * reduceChunk
+		if end > n {
+			end = n
+		}
+		for i := c * reduceChunk; i < end; i++ {
+			for k := range ed.constraints {
+				if con := &ed.constraints[k]; !con.soft && con.column[i] > con.limit {
+					reason[i] = 1
+					break
+				}
+			}
+			if reason[i] == 0 && ed.objective[i] <= 0 {
+				reason[i] = 2
+			}
+		}
+	})
+
+	if len(ed.constraints) == 1 && !ed.constraints[0].soft {
+		reduceDominated(ed.objective, ed.constraints[0].column, ed.constraints[0].limit, reason)
+	}
+
+	var removed []int
+	for i, r := range reason {
+		switch r {
+		case 0:
+			continue
+		case 1:
+			stats.Oversize++
+		case 2:
+			stats.NoValue++
+		case 3:
+			stats.Dominated++
+		}
+		removed = append(removed, i)
+	}
+	stats.Kept = n - len(removed)
+	return removed, stats
+}
+
+// reduceDominated marks (reason 3) the kept items that have at least M
+// dominators, M being the cardinality bound of limit. Ties in both value and
+// size are broken by index so that dominance is acyclic.
+func reduceDominated(value, size []float64, limit float64, reason []uint8) {
+	var items []int
+	for i, r := range reason {
+		if r == 0 {
+			items = append(items, i)
+		}
+	}
+	if len(items) < 2 {
+		return
+	}
+	bySize := append([]int(nil), items...)
+	byValue := append([]int(nil), items...)
+	runKnapsackPool(2, 2, func(t int) {
+		if t == 0 {
+			sort.Slice(bySize, func(a, b int) bool {
+				i, j := bySize[a], bySize[b]
+				if size[i] != size[j] {
+					return size[i] < size[j]
+				}
+				if value[i] != value[j] {
+					return value[i] > value[j]
+				}
+				return i < j
+			})
+		} else {
+			sort.Slice(byValue, func(a, b int) bool { return value[byValue[a]] > value[byValue[b]] })
+		}
+	})
+
+	// M: the largest count of smallest items that fits in limit. The slack
+	// keeps rounding from making M too small, which would be unsafe.
+	m := 0
+	var used float64
+	slack := 1e-9 * math.Max(1, math.Abs(limit))
+	for _, i := range bySize {
+		if used+size[i] > limit+slack {
+			break
+		}
+		used += size[i]
+		m++
+	}
+	if m >= len(items) {
+		return
+	}
+
+	// rank[i] is 1 + the number of distinct values above value[i].
+	rank := make([]int, len(value))
+	r := 0
+	for k, i := range byValue {
+		if k == 0 || value[i] != value[byValue[k-1]] {
+			r++
+		}
+		rank[i] = r
+	}
+	tree := make([]int, r+1)
+	for _, j := range bySize {
+		// Items swept so far are no larger; count those no less valuable.
+		count := 0
+		for x := rank[j]; x > 0; x -= x & -x {
+			count += tree[x]
+		}
+		if count >= m {
+			reason[j] = 3
+		}
+		for x := rank[j]; x <= r; x += x & -x {
+			tree[x]++
+		}
+	}
+}
+
+// reducedProblem prepares the problem without the removed items (sorted).
+// Blocks shrink as in ApplyDelta, "indices" blocks renumbered to the kept
+// items; blocks left empty are dropped.
+func (p *KnapsackPrepared) reducedProblem(removed []int) (*KnapsackPrepared, []int, error) {
+	n := p.numItems
+	index := make([]int, 0, n-len(removed))
+	prev := 0
+	for _, idx := range removed {
+		for i := prev; i < idx; i++ {
+			index = append(index, i)
+		}
+		prev = idx + 1
+	}
+	for i := prev; i < n; i++ {
+		index = append(index, i)
+	}
+
+	p.evalMu.Lock()
+	columns := make(map[string][]float64, len(p.evalCols))
+	for name, col := range p.evalCols {
+		kept := make([]float64, len(index))
+		for k, i := range index {
+			kept[k] = col[i]
+		}
+		columns[name] = kept
+	}
+	blocks, err := p.deltaBlocks(removed, 0)
+	p.evalMu.Unlock()
+	if err != nil {
+		return nil, nil, err
+	}
+
+	var buf bytes.Buffer
+	buf.WriteByte('{')
+	for _, s := range p.sections {
+		raw := s.raw
+		switch s.key {
+		case "items":
+			continue
+		case "blocks":
+			if blocks == nil {
+				break
+			}
+			var list []map[string]interface{}
+			json.Unmarshal(blocks, &list)
+			nonEmpty := list[:0]
+			for _, b := range list {
+				empty := termNumber(b, "count", 0) <= 0
+				if indices, ok := b["indices"].([]interface{}); ok {
+					empty = len(indices) == 0
+				}
+				if !empty {
+					nonEmpty = append(nonEmpty, b)
+				}
+			}
+			raw, _ = json.Marshal(nonEmpty)
+		}
+		if buf.Len() > 1 {
+			buf.WriteByte(',')
+		}
+		key, _ := json.Marshal(s.key)
+		buf.Write(key)
+		buf.WriteByte(':')
+		buf.Write(raw)
+	}
+	buf.WriteByte('}')
+
+	child, err := PrepareKnapsackColumns(buf.String(), columns)
+	if err != nil {
+		return nil, nil, fmt.Errorf("SolvePrepared: failed to prepare reduced problem: %w", err)
+	}
+	return child, index, nil
+}
@@ -0,0 +1,254 @@
+package chariot
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"math"
+)
+
+// knapsackRLRun is the most items rescored and written in one step.
+const knapsackRLRun = 4096
+
+// knapsackRLBinding keeps an objective attribute of a prepared problem
+// filled with scores from a live RL handle (see BindRLScores).
+type knapsackRLBinding struct {
+	attr    string
+	handle  *RLHandle
+	dense   []float32      // numItems x featDim, or nil with sparse
+	sparse  *RLSparseBatch // one candidate per item, or nil with dense
+	featDim int
+	items   int        // item count at binding
+	version uint64     // handle ModelVersion the cached scores were computed at
+	stale   SelectMask // items whose cached score is out of date
+	scores  []float64
+	buf     []byte
+	offsets []int32
+}
+
+// BindRLScores makes attr an RL-scored attribute: before each solve or
+// evaluation, items are scored by h from features (featDim per item, in
+// item order) and the scores are written into attr's column. The
+// objective must have a term on attr, e.g. {"attr": "rl_score",
+// "weight": 1.0}, so the solver maximizes expected reward within the
+// constraints, with no scores passing through Chariot values or JSON.
+//
+// Scores are cached per item: a solve rescores nothing until h learns
+// (see RLHandle.ModelVersion) or InvalidateRLScores marks items whose
+// features changed. features is used in place. attr gets a column of its
+// own if the problem doesn't have one; the attributes move into a column
+// file owned by the handle, as with ApplyDelta. Binding again replaces the
+// previous binding.
+//
+// Rescoring runs on h, so feedback for h's own batches should use batch
+// tokens (RLHandle.ScoreBatch): a library handle's token-less Learn applies
+// to the last batch it scored. Like ApplyDelta, binding and rescoring wait
+// for running solves on the handle, and solves wait for them, so a solve
+// never reads a column that is partly rescored. Each solve rescores, if
+// needed, when it starts and then uses those scores throughout: if another
+// goroutine learns on h while a solve runs, the learning shows in the next
+// solve, not in that one.
+func (p *KnapsackPrepared) BindRLScores(attr string, h *RLHandle, features []float32, featDim int) error {
+	if featDim <= 0 || len(features) != p.numItems*featDim {
+		return fmt.Errorf("BindRLScores: features must hold %d items x featDim %d values, got %d", p.numItems, featDim, len(features))
+	}
+	return p.bindRL(&knapsackRLBinding{attr: attr, handle: h, dense: features, featDim: featDim})
+}
+
+// BindRLScoresSparse is BindRLScores with one candidate of sparse features
+// in b per item (see RLHandle.ScoreSparseInto).
+func (p *KnapsackPrepared) BindRLScoresSparse(attr string, h *RLHandle, b *RLSparseBatch) error {
+	if b.Candidates() != p.numItems {
+		return fmt.Errorf("BindRLScores: %d candidates for %d items", b.Candidates(), p.numItems)
+	}
+	return p.bindRL(&knapsackRLBinding{attr: attr, handle: h, sparse: b})
+}
+
+func (p *KnapsackPrepared) bindRL(b *knapsackRLBinding) error {
+	if !b.handle.ToBool() {
+		return errors.New("BindRLScores: RL handle is closed")
+	}
+	found := false
+	for _, term := range p.objective {
+		if a, _ := term["attr"].(string); a == b.attr {
+			found = true
+		}
+	}
+	if !found {
+		return fmt.Errorf("BindRLScores: no objective term with attr %q", b.attr)
+	}
+
+	p.rlMu.Lock()
+	defer p.rlMu.Unlock()
+	p.mutMu.Lock()
+	defer p.mutMu.Unlock()
+	p.dropReduction()
+	p.evalMu.Lock()
+	defer p.evalMu.Unlock()
+	if p.released {
+		return errors.New("BindRLScores: prepared problem has been released")
+	}
+	if err := p.ownColumnsLocked(); err != nil {
+		return err
+	}
+	if _, ok := p.columnFile.entries[b.attr]; !ok {
+		cf := p.columnFile
+		cols := make([]KnapsackColumn, 0, len(cf.names)+1)
+		for _, name := range cf.names {
+			col, _ := cf.Float64(name)
+			cols = append(cols, KnapsackColumn{Name: name, Float64: col})
+		}
+		cols = append(cols, KnapsackColumn{Name: b.attr, Float64: make([]float64, p.numItems)})
+		if err := p.stageColumnsLocked(cols, p.numItems); err != nil {
+			return err
+		}
+	}
+	b.items = p.numItems
+	b.stale = NewSelectMask(p.numItems)
+	b.markAll(p.numItems)
+	b.version = b.handle.ModelVersion()
+	p.rl = b
+	return nil
+}
+
+// InvalidateRLScores marks items whose features changed in place, so the
+// next solve rescores them. With no items, every item is rescored.
+func (p *KnapsackPrepared) InvalidateRLScores(items ...int) error {
+	p.rlMu.Lock()
+	defer p.rlMu.Unlock()
+	b := p.rl
+	if b == nil {
+		return errors.New("InvalidateRLScores: no RL scores bound (see BindRLScores)")
+	}
+	for _, i := range items {
+		if i < 0 || i >= b.items {
+			return fmt.Errorf("InvalidateRLScores: item %d out of range [0, %d)", i, b.items)
+		}
+	}
+	if len(items) == 0 {
+		b.markAll(b.items)
+	}
+	for _, i := range items {
+		b.stale.Set(i, true)
+	}
+	return nil
+}
+
+// UnbindRLScores stops refreshing the bound attribute; its column keeps
+// the last scores written.
+func (p *KnapsackPrepared) UnbindRLScores() {
+	p.rlMu.Lock()
+	p.rl = nil
+	p.rlMu.Unlock()
+}
+
+// markAll marks the first n items stale.
+func (b *knapsackRLBinding) markAll(n int) {
+	for i := range b.stale {
+		b.stale[i] = ^uint64(0)
+	}
+	if tail := n & 63; tail != 0 {
+		b.stale[len(b.stale)-1] = 1<<uint(tail) - 1
+	}
+}
+
+// refreshRLScores rescores the stale items of the bound attribute, if any,
+// a run of consecutive items at a time, and writes each run's scores into
+// the column with one write. It holds mutMu for writing while it rescores,
+// so callers take mutMu for reading only after it returns. When nothing is
+// stale it holds mutMu for reading only, so concurrent solves do not wait
+// for each other.
+func (p *KnapsackPrepared) refreshRLScores(fn string) error {
+	p.rlMu.Lock()
+	defer p.rlMu.Unlock()
+	b := p.rl
+	if b == nil {
+		return nil
+	}
+	p.mutMu.RLock()
+	stale, err := p.checkRLLocked(fn, b)
+	p.mutMu.RUnlock()
+	if err != nil || !stale {
+		return err
+	}
+
+	p.mutMu.Lock()
+	defer p.mutMu.Unlock()
+	// ApplyDelta may have run between the two locks.
+	if stale, err := p.checkRLLocked(fn, b); err != nil || !stale {
+		return err
+	}
+	n := p.numItems
+	p.dropReduction()
+	p.evalMu.Lock()
+	defer p.evalMu.Unlock()
+	e, ok := p.columnFile.entries[b.attr]
+	if !ok || p.ownedFile == nil {
+		return fmt.Errorf("%s: RL-scored attribute %q lost its column; bind the scores again", fn, b.attr)
+	}
+	if b.scores == nil {
+		b.scores = make([]float64, knapsackRLRun)
+		b.buf = make([]byte, 8*knapsackRLRun)
+	}
+	for lo := 0; lo < n; {
+		if b.stale[lo>>6] == 0 {
+			lo = (lo>>6 + 1) << 6
+			continue
+		}
+		if !b.stale.Has(lo) {
+			lo++
+			continue
+		}
+		hi := lo + 1
+		for hi < n && hi-lo < knapsackRLRun && b.stale.Has(hi) {
+			hi++
+		}
+		if err := b.score(lo, hi); err != nil {
+			return fmt.Errorf("%s: %w", fn, err)
+		}
+		buf := b.buf[:8*(hi-lo)]
+		for k, s := range b.scores[:hi-lo] {
+			binary.LittleEndian.PutUint64(buf[8*k:], math.Float64bits(s))
+		}
+		off := e.offset + int64(lo)*8
+		if _, err := p.ownedFile.WriteAt(buf, off); err != nil {
+			return fmt.Errorf("%s: %w", fn, err)
+		}
+		if !mmapWritesVisible {
+			copy(p.columnFile.data[off:], buf)
+		}
+		lo = hi
+	}
+	clear(b.stale)
+	p.eval = nil
+	return nil
+}
+
+// checkRLLocked reports whether binding b has stale items, marking every
+// item stale if the model has learned since the last rescoring. The caller
+// holds rlMu and mutMu.
+func (p *KnapsackPrepared) checkRLLocked(fn string, b *knapsackRLBinding) (bool, error) {
+	if p.released {
+		return false, fmt.Errorf("%s: prepared problem has been released", fn)
+	}
+	if b.items != p.numItems {
+		return false, fmt.Errorf("%s: items changed since BindRLScores; bind the scores again", fn)
+	}
+	if v := b.handle.ModelVersion(); v != b.version {
+		b.markAll(b.items)
+		b.version = v
+	}
+	return b.stale.Count() > 0, nil
+}
+
+// score scores items lo..hi-1 into b.scores.
+func (b *knapsackRLBinding) score(lo, hi int) error {
+	out := b.scores[:hi-lo]
+	if b.sparse == nil {
+		d := b.featDim
+		return b.handle.ScoreInto(b.dense[lo*d:hi*d], d, out)
+	}
+	var sub *RLSparseBatch
+	sub, b.offsets = b.sparse.slice(lo, hi, b.offsets)
+	return b.handle.ScoreSparseInto(sub, out)
+}
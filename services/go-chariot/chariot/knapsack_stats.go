@@ -0,0 +1,64 @@
+package chariot
+
+import "time"
+
+// KnapsackStats reports where a solve spent its time. It is returned with
+// the "stats" option. The solver library reports no internal phases, so
+// Native covers config parsing, dominance filtering and the beam search.
+type KnapsackStats struct {
+	Wall     time.Duration // whole solve, as seen by the caller
+	Encode   time.Duration // building the config of a prepared solve
+	Reduce   time.Duration // computing the item reduction; 0 when cached
+	Native   time.Duration // inside the solver library, summed over Solves
+	Decode   time.Duration // copying selections out of C memory, summed over Solves
+	Refine   time.Duration // large-neighborhood search after the solve (lns_ms)
+	Solves   int           // library solves run (portfolio workers, anytime steps)
+	Items    int
+	Pruned   int    // items removed by the reduction
+	Selected int    // items in the solution
+	PeakRSS  int64  // process peak resident set size in bytes; 0 if unknown
+	Backend  string // as V2Solution.Backend
+}
+
+// knapsackTiming accumulates phase times as a solve moves up through the
+// portfolio, anytime and prepared layers.
+type knapsackTiming struct {
+	solves int
+	encode time.Duration
+	native time.Duration
+	decode time.Duration
+	refine time.Duration
+}
+
+func (t *knapsackTiming) add(o knapsackTiming) {
+	t.solves += o.solves
+	t.encode += o.encode
+	t.native += o.native
+	t.decode += o.decode
+	t.refine += o.refine
+}
+
+// setStats fills sol.Stats from its accumulated timing.
+func (sol *V2Solution) setStats(wall time.Duration) {
+	st := &KnapsackStats{
+		Wall:    wall,
+		Encode:  sol.timing.encode,
+		Native:  sol.timing.native,
+		Decode:  sol.timing.decode,
+		Refine:  sol.timing.refine,
+		Solves:  sol.timing.solves,
+		Items:   sol.NumItems,
+		PeakRSS: knapsackPeakRSS(),
+		Backend: sol.Backend,
+	}
+	for _, v := range sol.Select {
+		st.Selected += v
+	}
+	if r := sol.Reduction; r != nil {
+		st.Pruned = r.Items - r.Kept
+		if !r.Cached {
+			st.Reduce = r.Elapsed
+		}
+	}
+	sol.Stats = st
+}
@@ -0,0 +1,8 @@
+//go:build !linux && !darwin
+
+package chariot
+
+// knapsackPeakRSS is not available on this platform.
+func knapsackPeakRSS() int64 {
+	return 0
+}
@@ -0,0 +1,21 @@
+//go:build linux || darwin
+
+package chariot
+
+import (
+	"runtime"
+	"syscall"
+)
+
+// knapsackPeakRSS returns the process's peak resident set size in bytes.
+// It includes memory allocated inside the solver library.
+func knapsackPeakRSS() int64 {
+	var ru syscall.Rusage
+	if err := syscall.Getrusage(syscall.RUSAGE_SELF, &ru); err != nil {
+		return 0
+	}
+	if runtime.GOOS == "darwin" {
+		return int64(ru.Maxrss) // bytes
+	}
+	return int64(ru.Maxrss) * 1024 // kilobytes
+}
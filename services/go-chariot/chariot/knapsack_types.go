@@ -1,10 +1,60 @@
 package chariot
 
+import "unsafe"
+
 // V2Solution is defined once for the whole package and reused by all OS builds.
 type V2Solution struct {
 	NumItems  int
-	Select    []int   // length == NumItems; 0/1 per item
-	Objective float64 // sum of weighted objective terms
-	Penalty   float64 // total penalty from soft constraints
-	Total     float64 // Objective - Penalty
+	Select    []int      // length == NumItems; 0/1 per item
+	Mask      SelectMask // Select packed 64 items per word
+	Objective float64    // sum of weighted objective terms
+	Penalty   float64    // total penalty from soft constraints
+	Total     float64    // Objective - Penalty
+	Backend   string     // what ran the solve: "cpu", "metal", or "go" for Go-side searches
+
+	Reduction *KnapsackReduction // set when solved with the "reduce" option
+	Stats     *KnapsackStats     // set when solved with the "stats" option
+	Bound     *KnapsackBound     // LP upper bound; set by prepared solves whose options use it (see needsBound)
+
+	timing knapsackTiming
+}
+
+// decodeSelectV2 copies the solver's int[n] selection (ks_v2_select_ptr)
+// out of C memory, producing the 0/1 slice and its packed mask. A nil ptr
+// yields an empty selection.
+func decodeSelectV2(ptr unsafe.Pointer, n int) ([]int, SelectMask) {
+	sel := make([]int, n)
+	mask := NewSelectMask(n)
+	decodeSelectV2Into(ptr, sel, mask)
+	return sel, mask
+}
+
+// decodeSelectV2Into is decodeSelectV2 writing into sel (len n) and mask
+// ((n+63)/64 words) in one pass over a typed view of the C array. Every
+// entry is written, so the buffers may hold an earlier selection.
+func decodeSelectV2Into(ptr unsafe.Pointer, sel []int, mask SelectMask) {
+	n := len(sel)
+	if ptr == nil || n == 0 {
+		clear(sel)
+		clear(mask)
+		return
+	}
+	src := unsafe.Slice((*int32)(ptr), n)
+	for w := range mask {
+		base := w << 6
+		end := base + 64
+		if end > n {
+			end = n
+		}
+		var word uint64
+		for i, v := range src[base:end] {
+			var bit int
+			if v != 0 {
+				bit = 1
+				word |= 1 << uint(i)
+			}
+			sel[base+i] = bit
+		}
+		mask[w] = word
+	}
 }
@@ -0,0 +1,353 @@
+package chariot
+
+import (
+	"fmt"
+	"math"
+	"sort"
+	"time"
+)
+
+// warmSwapCandidates is how many of the best unselected items are tried as
+// swap-ins per round, and warmSwapRounds bounds the number of rounds.
+const (
+	warmSwapCandidates = 64
+	warmSwapRounds     = 4
+)
+
+// warmCheckEvery is how many items repair and improve visit between
+// deadline checks.
+const warmCheckEvery = 4096
+
+// SolveWarm re-solves the prepared problem starting from prior, a selection
+// from an earlier solve, instead of running the beam search from scratch.
+// It is meant for re-solves after small changes (overrides, or data updates
+// to the handle), where the old solution is already close to a good one.
+//
+// The search works on the handle's columns (see EvaluateSelect). First it
+// drops the items with the least value per unit of violated capacity until
+// every hard constraint holds. Then it adds the best unselected items that
+// still fit and raise the total. Finally it runs a few rounds of one-for-one
+// swaps. The time taken grows with the item count, not with the beam width.
+// A nil prior starts from an empty selection. The result is a local
+// optimum: when the problem has changed a lot, a full SolvePrepared can do
+// better. Problems with constraints other than capacity constraints are
+// refused.
+func (p *KnapsackPrepared) SolveWarm(prior SelectMask, overridesJSON string) (*V2Solution, error) {
+	ov, err := parseKnapsackOverrides("SolveWarm", overridesJSON)
+	if err != nil {
+		return nil, err
+	}
+	if err := p.refreshRLScores("SolveWarm"); err != nil {
+		return nil, err
+	}
+	p.mutMu.RLock()
+	defer p.mutMu.RUnlock()
+	// The search only scores capacity constraints.
+	for _, con := range p.constraints {
+		if kind, _ := con["kind"].(string); kind != "capacity" {
+			return nil, fmt.Errorf("SolveWarm: constraint kind %q is not supported", kind)
+		}
+	}
+	ed, err := p.evalColumnsWith("SolveWarm", ov)
+	if err != nil {
+		return nil, err
+	}
+
+	n := ed.numItems
+	sel := NewSelectMask(n)
+	if prior != nil {
+		if len(prior) != len(sel) {
+			return nil, fmt.Errorf("SolveWarm: prior has %d words, expected %d", len(prior), len(sel))
+		}
+		copy(sel, prior)
+		if tail := n & 63; tail != 0 {
+			sel[len(sel)-1] &= 1<<uint(tail) - 1
+		}
+	}
+
+	ws := newWarmSearch(ed, sel)
+	ws.repair()
+	ws.improve()
+
+	ev := ed.evaluate(ws.sel)
+	return &V2Solution{
+		NumItems:  n,
+		Select:    ws.sel.Unpack(n),
+		Mask:      ws.sel,
+		Objective: ev.Objective,
+		Penalty:   ev.Penalty,
+		Total:     ev.Total,
+		Backend:   "go",
+	}, nil
+}
+
+// warmSearch is the incremental state of a SolveWarm local search.
+type warmSearch struct {
+	ed   *knapsackEvalData
+	sel  SelectMask
+	obj  float64
+	use  []float64 // per-constraint usage of the current selection
+	tmp  []float64
+	size []float64 // per-item capacity footprint, each constraint scaled by its limit
+
+	// deadline, when set, stops repair and improve early, leaving the
+	// selection they have reached (see refineLNS).
+	deadline time.Time
+}
+
+func newWarmSearch(ed *knapsackEvalData, sel SelectMask) *warmSearch {
+	ws := &warmSearch{
+		ed:   ed,
+		sel:  sel,
+		obj:  maskedSum(sel, ed.objective),
+		use:  make([]float64, len(ed.constraints)),
+		tmp:  make([]float64, len(ed.constraints)),
+		size: make([]float64, ed.numItems),
+	}
+	for k := range ed.constraints {
+		c := &ed.constraints[k]
+		ws.use[k] = maskedSum(sel, c.column)
+		if c.limit > 0 {
+			for i, v := range c.column {
+				ws.size[i] += v / c.limit
+			}
+		}
+	}
+	return ws
+}
+
+// clone returns an independent copy sharing the read-only columns.
+func (ws *warmSearch) clone() *warmSearch {
+	c := *ws
+	c.sel = append(SelectMask(nil), ws.sel...)
+	c.use = append([]float64(nil), ws.use...)
+	c.tmp = make([]float64, len(ws.tmp))
+	return &c
+}
+
+// expired reports whether ws has a deadline and it has passed.
+func (ws *warmSearch) expired() bool {
+	return !ws.deadline.IsZero() && time.Now().After(ws.deadline)
+}
+
+// total returns the total of the current selection.
+func (ws *warmSearch) total() float64 {
+	return ws.obj - ws.penalty(ws.use)
+}
+
+// penalty returns the soft penalty for usage.
+func (ws *warmSearch) penalty(use []float64) float64 {
+	var pen float64
+	for k := range ws.ed.constraints {
+		c := &ws.ed.constraints[k]
+		if excess := use[k] - c.limit; c.soft && excess > 0 {
+			pen += c.penalty * math.Pow(excess, c.power)
+		}
+	}
+	return pen
+}
+
+// feasible reports whether usage satisfies every hard constraint.
+func (ws *warmSearch) feasible(use []float64) bool {
+	for k := range ws.ed.constraints {
+		if c := &ws.ed.constraints[k]; !c.soft && use[k] > c.limit {
+			return false
+		}
+	}
+	return true
+}
+
+// tryMove evaluates adding item in (if >= 0) and removing item out (if >= 0).
+// It returns the change in total and whether the result is feasible, leaving
+// the resulting usage in ws.tmp.
+func (ws *warmSearch) tryMove(in, out int) (float64, bool) {
+	obj := ws.obj
+	if in >= 0 {
+		obj += ws.ed.objective[in]
+	}
+	if out >= 0 {
+		obj -= ws.ed.objective[out]
+	}
+	for k := range ws.ed.constraints {
+		u := ws.use[k]
+		col := ws.ed.constraints[k].column
+		if in >= 0 {
+			u += col[in]
+		}
+		if out >= 0 {
+			u -= col[out]
+		}
+		ws.tmp[k] = u
+	}
+	return (obj - ws.penalty(ws.tmp)) - (ws.obj - ws.penalty(ws.use)), ws.feasible(ws.tmp)
+}
+
+// apply commits the move last evaluated by tryMove.
+func (ws *warmSearch) apply(in, out int) {
+	if in >= 0 {
+		ws.sel.Set(in, true)
+		ws.obj += ws.ed.objective[in]
+	}
+	if out >= 0 {
+		ws.sel.Set(out, false)
+		ws.obj -= ws.ed.objective[out]
+	}
+	copy(ws.use, ws.tmp)
+}
+
+// repair removes items until every hard constraint holds, cheapest value per
+// unit of violated capacity first. Stopped by the deadline, it can leave a
+// constraint broken.
+func (ws *warmSearch) repair() {
+	for pass := 0; pass <= len(ws.ed.constraints) && !ws.expired(); pass++ {
+		var violated []int
+		for k := range ws.ed.constraints {
+			if c := &ws.ed.constraints[k]; !c.soft && ws.use[k] > c.limit {
+				violated = append(violated, k)
+			}
+		}
+		if len(violated) == 0 {
+			return
+		}
+
+		type cand struct {
+			item  int
+			ratio float64
+		}
+		var cands []cand
+		for i := 0; i < ws.ed.numItems; i++ {
+			if !ws.sel.Has(i) {
+				continue
+			}
+			var relief float64
+			for _, k := range violated {
+				c := &ws.ed.constraints[k]
+				relief += c.column[i] / (ws.use[k] - c.limit)
+			}
+			if relief > 0 {
+				cands = append(cands, cand{i, ws.ed.objective[i] / relief})
+			}
+		}
+		sort.Slice(cands, func(a, b int) bool {
+			if cands[a].ratio != cands[b].ratio {
+				return cands[a].ratio < cands[b].ratio
+			}
+			return cands[a].item < cands[b].item
+		})
+
+		for k, c := range cands {
+			if k%warmCheckEvery == warmCheckEvery-1 && ws.expired() {
+				return
+			}
+			ws.tryMove(-1, c.item)
+			ws.apply(-1, c.item)
+			if ws.violatedNone(violated) {
+				break
+			}
+		}
+	}
+}
+
+func (ws *warmSearch) violatedNone(ks []int) bool {
+	for _, k := range ks {
+		if ws.use[k] > ws.ed.constraints[k].limit {
+			return false
+		}
+	}
+	return true
+}
+
+// improve greedily adds items, then tries one-for-one swaps that raise the
+// total, re-running the greedy pass after each round that changed anything.
+func (ws *warmSearch) improve() {
+	if ws.expired() {
+		return
+	}
+	// Best value per unit of capacity first; items needing no capacity
+	// lead. Ties keep item order.
+	order := make([]int, 0, ws.ed.numItems)
+	density := make([]float64, ws.ed.numItems)
+	for j := 0; j < ws.ed.numItems; j++ {
+		if ws.ed.objective[j] <= 0 {
+			continue
+		}
+		order = append(order, j)
+		density[j] = math.Inf(1)
+		if ws.size[j] > 0 {
+			density[j] = ws.ed.objective[j] / ws.size[j]
+		}
+	}
+	sort.Slice(order, func(a, b int) bool {
+		x, y := order[a], order[b]
+		return density[x] > density[y] || (density[x] == density[y] && x < y)
+	})
+
+	for round := 0; round <= warmSwapRounds; round++ {
+		var rejected []int
+		for k, j := range order {
+			if k%warmCheckEvery == warmCheckEvery-1 && ws.expired() {
+				return
+			}
+			if ws.sel.Has(j) {
+				continue
+			}
+			if gain, ok := ws.tryMove(j, -1); ok && gain > warmEpsilon(ws.obj) {
+				ws.apply(j, -1)
+			} else if len(rejected) < warmSwapCandidates {
+				rejected = append(rejected, j)
+			}
+		}
+		if round == warmSwapRounds || ws.expired() || !ws.swapRound(rejected) {
+			return
+		}
+	}
+}
+
+// swapRound tries to swap each rejected item in for a selected item of lower
+// value. It reports whether any swap was made.
+func (ws *warmSearch) swapRound(rejected []int) bool {
+	selected := make([]int, 0, ws.sel.Count())
+	for i := 0; i < ws.ed.numItems; i++ {
+		if ws.sel.Has(i) {
+			selected = append(selected, i)
+		}
+	}
+	obj := ws.ed.objective
+	sort.Slice(selected, func(a, b int) bool {
+		x, y := selected[a], selected[b]
+		return obj[x] < obj[y] || (obj[x] == obj[y] && x < y)
+	})
+
+	swapped := false
+	for _, j := range rejected {
+		if ws.sel.Has(j) {
+			continue
+		}
+		if ws.expired() {
+			break
+		}
+		best, bestGain := -1, warmEpsilon(ws.obj)
+		for _, i := range selected {
+			if ws.ed.objective[i] >= ws.ed.objective[j] {
+				break
+			}
+			if !ws.sel.Has(i) {
+				continue
+			}
+			if gain, ok := ws.tryMove(j, i); ok && gain > bestGain {
+				best, bestGain = i, gain
+			}
+		}
+		if best >= 0 {
+			ws.tryMove(j, best)
+			ws.apply(j, best)
+			swapped = true
+		}
+	}
+	return swapped
+}
+
+// warmEpsilon is the smallest total gain the search accepts as an improvement.
+func warmEpsilon(total float64) float64 {
+	return 1e-12 * math.Max(1, math.Abs(total))
+}
@@ -0,0 +1,219 @@
+package chariot
+
+import (
+	"errors"
+	"fmt"
+)
+
+// Float32Buffer is a contiguous float32 vector value. RL bindings hand its
+// storage to the native library in place, so features built once in a
+// buffer are scored with no per-element conversion.
+type Float32Buffer struct {
+	Data []float32
+}
+
+// Float64Buffer is a contiguous float64 vector value, used as a reusable
+// output buffer for scores.
+type Float64Buffer struct {
+	Data []float64
+}
+
+// Type implements Value interface
+func (b *Float32Buffer) Type() string {
+	return "Float32Buffer"
+}
+
+// String implements Value interface
+func (b *Float32Buffer) String() string {
+	return fmt.Sprintf("<Float32Buffer:%d>", len(b.Data))
+}
+
+// ToBool implements Value interface
+func (b *Float32Buffer) ToBool() bool {
+	return len(b.Data) > 0
+}
+
+// Type implements Value interface
+func (b *Float64Buffer) Type() string {
+	return "Float64Buffer"
+}
+
+// String implements Value interface
+func (b *Float64Buffer) String() string {
+	return fmt.Sprintf("<Float64Buffer:%d>", len(b.Data))
+}
+
+// ToBool implements Value interface
+func (b *Float64Buffer) ToBool() bool {
+	return len(b.Data) > 0
+}
+
+// registerRLBufferFunctions registers the typed buffer functions used by
+// the RL fast path (rlScoreInto).
+func registerRLBufferFunctions(rt *Runtime) {
+	// float32Buffer(sizeOrArray) -> Float32Buffer
+	// float64Buffer(sizeOrArray) -> Float64Buffer
+	//
+	// Creates a zeroed buffer of the given length, or converts a numeric
+	// array once.
+	//
+	// Example:
+	//   setq(features, float32Buffer(mul(numCandidates, featDim)))
+	//   setq(scores, float64Buffer(numCandidates))
+	rt.Register("float32Buffer", func(args ...Value) (Value, error) {
+		n, from, err := bufferSourceArg("float32Buffer", args)
+		if err != nil {
+			return nil, err
+		}
+		buf := &Float32Buffer{Data: make([]float32, n)}
+		for i, v := range from {
+			buf.Data[i] = float32(v)
+		}
+		return buf, nil
+	})
+
+	rt.Register("float64Buffer", func(args ...Value) (Value, error) {
+		n, from, err := bufferSourceArg("float64Buffer", args)
+		if err != nil {
+			return nil, err
+		}
+		buf := &Float64Buffer{Data: make([]float64, n)}
+		copy(buf.Data, from)
+		return buf, nil
+	})
+
+	// bufferGet(buffer, index) -> number
+	rt.Register("bufferGet", func(args ...Value) (Value, error) {
+		if len(args) != 2 {
+			return nil, errors.New("bufferGet requires 2 arguments: buffer, index")
+		}
+		buf, n, err := bufferArg("bufferGet", args[0])
+		if err != nil {
+			return nil, err
+		}
+		i, err := bufferIndexArg("bufferGet", args[1], n)
+		if err != nil {
+			return nil, err
+		}
+		switch b := buf.(type) {
+		case *Float32Buffer:
+			return Number(b.Data[i]), nil
+		default:
+			return Number(b.(*Float64Buffer).Data[i]), nil
+		}
+	})
+
+	// bufferSet(buffer, index, value) -> buffer
+	rt.Register("bufferSet", func(args ...Value) (Value, error) {
+		if len(args) != 3 {
+			return nil, errors.New("bufferSet requires 3 arguments: buffer, index, value")
+		}
+		buf, n, err := bufferArg("bufferSet", args[0])
+		if err != nil {
+			return nil, err
+		}
+		i, err := bufferIndexArg("bufferSet", args[1], n)
+		if err != nil {
+			return nil, err
+		}
+		v := args[2]
+		if tvar, ok := v.(ScopeEntry); ok {
+			v = tvar.Value
+		}
+		num, ok := v.(Number)
+		if !ok {
+			return nil, fmt.Errorf("bufferSet: value must be number, got %T", v)
+		}
+		switch b := buf.(type) {
+		case *Float32Buffer:
+			b.Data[i] = float32(num)
+		default:
+			b.(*Float64Buffer).Data[i] = float64(num)
+		}
+		return buf, nil
+	})
+
+	// bufferToArray(buffer) -> array
+	rt.Register("bufferToArray", func(args ...Value) (Value, error) {
+		if len(args) != 1 {
+			return nil, errors.New("bufferToArray requires 1 argument: buffer")
+		}
+		buf, n, err := bufferArg("bufferToArray", args[0])
+		if err != nil {
+			return nil, err
+		}
+		elems := make([]Value, n)
+		switch b := buf.(type) {
+		case *Float32Buffer:
+			for i, v := range b.Data {
+				elems[i] = Number(v)
+			}
+		default:
+			for i, v := range b.(*Float64Buffer).Data {
+				elems[i] = Number(v)
+			}
+		}
+		return NewArrayWithValues(elems), nil
+	})
+}
+
+// bufferSourceArg reads the size-or-array argument of float32Buffer and
+// float64Buffer.
+func bufferSourceArg(fn string, args []Value) (int, []float64, error) {
+	if len(args) != 1 {
+		return 0, nil, fmt.Errorf("%s requires 1 argument: size or numeric array", fn)
+	}
+	arg := args[0]
+	if tvar, ok := arg.(ScopeEntry); ok {
+		arg = tvar.Value
+	}
+	switch v := arg.(type) {
+	case Number:
+		if v < 0 || v != Number(int(v)) {
+			return 0, nil, fmt.Errorf("%s: size must be a non-negative integer, got %v", fn, v)
+		}
+		return int(v), nil, nil
+	case *ArrayValue:
+		from := make([]float64, len(v.Elements))
+		for i, e := range v.Elements {
+			num, ok := e.(Number)
+			if !ok {
+				return 0, nil, fmt.Errorf("%s: element %d is not numeric, got %T", fn, i, e)
+			}
+			from[i] = float64(num)
+		}
+		return len(from), from, nil
+	default:
+		return 0, nil, fmt.Errorf("%s: argument must be size or numeric array, got %T", fn, arg)
+	}
+}
+
+// bufferArg unwraps a Float32Buffer or Float64Buffer argument and returns its length.
+func bufferArg(fn string, arg Value) (Value, int, error) {
+	if tvar, ok := arg.(ScopeEntry); ok {
+		arg = tvar.Value
+	}
+	switch b := arg.(type) {
+	case *Float32Buffer:
+		return b, len(b.Data), nil
+	case *Float64Buffer:
+		return b, len(b.Data), nil
+	default:
+		return nil, 0, fmt.Errorf("%s: first argument must be float32Buffer or float64Buffer, got %T", fn, arg)
+	}
+}
+
+func bufferIndexArg(fn string, arg Value, n int) (int, error) {
+	if tvar, ok := arg.(ScopeEntry); ok {
+		arg = tvar.Value
+	}
+	num, ok := arg.(Number)
+	if !ok || num != Number(int(num)) {
+		return 0, fmt.Errorf("%s: index must be integer, got %v", fn, arg)
+	}
+	i := int(num)
+	if i < 0 || i >= n {
+		return 0, fmt.Errorf("%s: index %d out of range [0, %d)", fn, i, n)
+	}
+	return i, nil
+}
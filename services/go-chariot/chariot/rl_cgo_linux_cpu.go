@@ -59,52 +59,48 @@ func rlInit_impl(configJSON string) (interface{}, error) {
 }
 
 // rlScore_impl is the Linux CPU implementation of rlScore
-// It wraps rl_score_batch_with_features from librl_support.a
-func rlScore_impl(handle interface{}, features []float64, featDim int) ([]float64, error) {
+// It wraps rl_score_batch_with_features from librl_support.a. features and
+// out are handed to C in place (C float and double are float32 and float64),
+// so scoring copies and allocates nothing.
+func rlScore_impl(handle interface{}, features []float32, featDim int, out []float64) error {
 	if handle == nil {
-		return nil, errors.New("rlScore: nil handle")
+		return errors.New("rlScore: nil handle")
 	}
 
 	h, ok := handle.(C.rl_handle_t)
 	if !ok {
-		return nil, fmt.Errorf("rlScore: invalid handle type %T", handle)
+		return fmt.Errorf("rlScore: invalid handle type %T", handle)
 	}
 
 	if len(features) == 0 {
-		return nil, errors.New("rlScore: empty features array")
+		return errors.New("rlScore: empty features array")
 	}
 
 	if featDim <= 0 {
-		return nil, errors.New("rlScore: featDim must be > 0")
+		return errors.New("rlScore: featDim must be > 0")
 	}
 
 	numCandidates := len(features) / featDim
 	if len(features)%featDim != 0 {
-		return nil, fmt.Errorf("rlScore: features length %d not divisible by featDim %d", len(features), featDim)
+		return fmt.Errorf("rlScore: features length %d not divisible by featDim %d", len(features), featDim)
 	}
-
-	// Convert features to C float array
-	cFeatures := make([]C.float, len(features))
-	for i, f := range features {
-		cFeatures[i] = C.float(f)
+	if len(out) != numCandidates {
+		return fmt.Errorf("rlScore: %d scores for %d candidates", len(out), numCandidates)
 	}
 
-	// Allocate output scores array
-	scores := make([]C.double, numCandidates)
-
-	// Error buffer
-	const errLen = 512
-	errBuf := make([]byte, errLen)
+	errBuf := rlErrBufPool.Get().(*[rlErrLen]byte)
+	defer rlErrBufPool.Put(errBuf)
+	errBuf[0] = 0
 	cErr := (*C.char)(unsafe.Pointer(&errBuf[0]))
 
 	rc := C.rl_score_batch_with_features(
 		h,
-		(*C.float)(unsafe.Pointer(&cFeatures[0])),
+		(*C.float)(unsafe.Pointer(&features[0])),
 		C.int(featDim),
 		C.int(numCandidates),
-		(*C.double)(unsafe.Pointer(&scores[0])),
+		(*C.double)(unsafe.Pointer(&out[0])),
 		cErr,
-		C.int(errLen),
+		C.int(rlErrLen),
 	)
 
 	if rc != 0 {
@@ -112,16 +108,68 @@ func rlScore_impl(handle interface{}, features []float64, featDim int) ([]float6
 		if errMsg == "" {
 			errMsg = "rl_score_batch_with_features failed (unknown error)"
 		}
-		return nil, fmt.Errorf("rlScore: %s", errMsg)
+		return fmt.Errorf("rlScore: %s", errMsg)
+	}
+
+	return nil
+}
+
+// rlPrepare_impl is the Linux CPU implementation of rlPrepare
+// It wraps rl_prepare_features from librl_support.a (select mode). masks
+// holds numCandidates rows of numItems 0/1 bytes; features receives
+// numCandidates*featDim values in place.
+func rlPrepare_impl(handle interface{}, masks []byte, numItems int, features []float32) error {
+	if handle == nil {
+		return errors.New("rlPrepare: nil handle")
+	}
+
+	h, ok := handle.(C.rl_handle_t)
+	if !ok {
+		return fmt.Errorf("rlPrepare: invalid handle type %T", handle)
+	}
+
+	if numItems <= 0 || len(masks) == 0 || len(masks)%numItems != 0 {
+		return fmt.Errorf("rlPrepare: masks length %d not a positive multiple of numItems %d", len(masks), numItems)
+	}
+	numCandidates := len(masks) / numItems
+	featDim := int(C.rl_get_feat_dim(h))
+	if featDim <= 0 || len(features) != numCandidates*featDim {
+		return fmt.Errorf("rlPrepare: features length %d != %d candidates x feat_dim %d", len(features), numCandidates, featDim)
 	}
 
-	// Convert C scores to Go slice
-	result := make([]float64, numCandidates)
-	for i := 0; i < numCandidates; i++ {
-		result[i] = float64(scores[i])
+	errBuf := rlErrBufPool.Get().(*[rlErrLen]byte)
+	defer rlErrBufPool.Put(errBuf)
+	errBuf[0] = 0
+	cErr := (*C.char)(unsafe.Pointer(&errBuf[0]))
+
+	rc := C.rl_prepare_features(
+		h,
+		(*C.uchar)(unsafe.Pointer(&masks[0])),
+		C.int(numItems),
+		C.int(numCandidates),
+		0,
+		(*C.float)(unsafe.Pointer(&features[0])),
+		cErr,
+		C.int(rlErrLen),
+	)
+	if rc != 0 {
+		errMsg := C.GoString(cErr)
+		if errMsg == "" {
+			errMsg = "rl_prepare_features failed (unknown error)"
+		}
+		return fmt.Errorf("rlPrepare: %s", errMsg)
 	}
 
-	return result, nil
+	return nil
+}
+
+// rlFeatDim_impl is the Linux CPU implementation of rlFeatDim
+func rlFeatDim_impl(handle interface{}) int {
+	h, ok := handle.(C.rl_handle_t)
+	if !ok || h == nil {
+		return -1
+	}
+	return int(C.rl_get_feat_dim(h))
 }
 
 // rlLearn_impl is the Linux CPU implementation of rlLearn
@@ -149,12 +197,12 @@ func rlLearn_impl(handle interface{}, feedbackJSON string) error {
 	cFeedback := C.CString(feedbackJSON)
 	defer C.free(unsafe.Pointer(cFeedback))
 
-	// Error buffer
-	const errLen = 512
-	errBuf := make([]byte, errLen)
+	errBuf := rlErrBufPool.Get().(*[rlErrLen]byte)
+	defer rlErrBufPool.Put(errBuf)
+	errBuf[0] = 0
 	cErr := (*C.char)(unsafe.Pointer(&errBuf[0]))
 
-	rc := C.rl_learn_batch(h, cFeedback, cErr, C.int(errLen))
+	rc := C.rl_learn_batch(h, cFeedback, cErr, C.int(rlErrLen))
 	if rc != 0 {
 		errMsg := C.GoString(cErr)
 		if errMsg == "" {
@@ -0,0 +1,222 @@
+package chariot
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"math"
+	"sync"
+)
+
+// Covariance models accepted in the rlInit "covariance" option.
+const (
+	rlCovarianceLibrary  = "library"  // the RL library's model (default)
+	rlCovarianceDiagonal = "diagonal" // rlDiagModel, kept in Go
+)
+
+// rlDiagModel is LinUCB with a diagonal covariance, kept in Go. Feature i
+// has a ridge term a[i] = 1 + sum of x_i^2 over learned candidates and a
+// reward sum b[i] = sum of reward*x_i, and a candidate scores
+//
+//	sum_i x_i*b[i]/a[i] + alpha*sqrt(sum_i x_i^2/a[i])
+//
+// so exploration shrinks along the features that have been seen. State is
+// 16 bytes per feature: a and b accumulate in float64, so a feature seen
+// millions of times still registers each update, where a float32 sum
+// stops growing past 2^24. Scoring and learning touch only the non-zero
+// features of a candidate, which keeps sparse one-hot features cheap at
+// any feat_dim. Scoring runs concurrently; learning is exclusive.
+//
+// A model opened from a shared snapshot (see OpenRLSnapshot) scores from
+// the read-only mapping and keeps its own updates in local. Once
+// TrackDeltas is called, a model also records what it learns in pend for
+// TakeDelta; until then pend is nil and learning records nothing extra.
+type rlDiagModel struct {
+	dim     int
+	alpha   float64
+	shared  bool // opened from a shared snapshot
+	mu      sync.RWMutex
+	a, b    []float64 // nil once closed
+	mapped  []byte    // the mapping a and b alias, if any
+	local   map[int32]rlDiagStat
+	pend    map[int32]rlDiagStat
+	deltaMu sync.Mutex // serializes taking deltas, which encode and clear pend in two steps
+}
+
+func newRLDiagModel(featDim int, alpha float64) *rlDiagModel {
+	m := &rlDiagModel{dim: featDim, alpha: alpha, a: make([]float64, featDim), b: make([]float64, featDim)}
+	for i := range m.a {
+		m.a[i] = 1
+	}
+	return m
+}
+
+var errRLDiagClosed = errors.New("rlScore: handle is closed")
+
+// scoreDense scores len(out) candidates of dim features each.
+func (m *rlDiagModel) scoreDense(features []float32, out []float64) error {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.a == nil {
+		return errRLDiagClosed
+	}
+	d := m.dim
+	for c := range out {
+		var s, u float64
+		for i, x := range features[c*d : (c+1)*d] {
+			if x != 0 {
+				s, u = m.term(s, u, i, x)
+			}
+		}
+		out[c] = s + m.alpha*math.Sqrt(u)
+	}
+	return nil
+}
+
+// scoreSparse scores the candidates of sb, which has been checked.
+func (m *rlDiagModel) scoreSparse(sb *RLSparseBatch, out []float64) error {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.a == nil {
+		return errRLDiagClosed
+	}
+	for c := range out {
+		var s, u float64
+		for k := sb.Offsets[c]; k < sb.Offsets[c+1]; k++ {
+			s, u = m.term(s, u, int(sb.Index[k]), sb.Values[k])
+		}
+		out[c] = s + m.alpha*math.Sqrt(u)
+	}
+	return nil
+}
+
+// term adds feature i with value x to the mean s and the variance u.
+func (m *rlDiagModel) term(s, u float64, i int, x float32) (float64, float64) {
+	st := m.stat(i)
+	xf := float64(x)
+	return s + xf*st.b/st.a, u + xf*xf/st.a
+}
+
+// stat returns feature i's ridge term and reward sum.
+func (m *rlDiagModel) stat(i int) rlDiagStat {
+	st := rlDiagStat{m.a[i], m.b[i]}
+	if m.local != nil {
+		if l, ok := m.local[int32(i)]; ok {
+			st.a += l.a
+			st.b += l.b
+		}
+	}
+	return st
+}
+
+// add adds da and db to feature i's ridge term and reward sum.
+func (m *rlDiagModel) add(i int32, da, db float64) {
+	if m.local == nil {
+		m.a[i] += da
+		m.b[i] += db
+		return
+	}
+	l := m.local[i]
+	m.local[i] = rlDiagStat{l.a + da, l.b + db}
+}
+
+// learn applies rewards[c] to candidate c of batch; candidates without a
+// reward are left out.
+func (m *rlDiagModel) learn(batch rlBatch, rewards []float64) error {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.a == nil {
+		return errors.New("rlLearn: handle is closed")
+	}
+	add := func(i int, x float32, r float64) {
+		xf := float64(x)
+		da, db := xf*xf, r*xf
+		m.add(int32(i), da, db)
+		if m.pend != nil {
+			p := m.pend[int32(i)]
+			m.pend[int32(i)] = rlDiagStat{p.a + da, p.b + db}
+		}
+	}
+	for c, r := range rewards {
+		if sb := batch.sparse; sb != nil {
+			for k := sb.Offsets[c]; k < sb.Offsets[c+1]; k++ {
+				add(int(sb.Index[k]), sb.Values[k], r)
+			}
+			continue
+		}
+		d := batch.featDim
+		for i, x := range batch.features[c*d : (c+1)*d] {
+			if x != 0 {
+				add(i, x, r)
+			}
+		}
+	}
+	return nil
+}
+
+func (m *rlDiagModel) close() {
+	m.mu.Lock()
+	m.a, m.b, m.local, m.pend = nil, nil, nil, nil
+	if m.mapped != nil {
+		munmapFile(m.mapped)
+		m.mapped = nil
+	}
+	m.mu.Unlock()
+}
+
+// rlFeedbackRewards returns the reward of each of the n candidates of a
+// batch from feedbackJSON, reading the schemas the library accepts (see
+// rlLearn) in the same order: "rewards" (the first n), then "chosen", then
+// "events" (candidates without an event get 0).
+func rlFeedbackRewards(feedbackJSON string, n int) ([]float64, error) {
+	var fb struct {
+		Rewards    []float64 `json:"rewards"`
+		Chosen     []float64 `json:"chosen"`
+		BaseReward *float64  `json:"base_reward"`
+		Decay      *float64  `json:"decay"`
+		Positions  []float64 `json:"positions"`
+		Events     []struct {
+			Idx    int     `json:"idx"`
+			Reward float64 `json:"reward"`
+		} `json:"events"`
+	}
+	if err := json.Unmarshal([]byte(feedbackJSON), &fb); err != nil {
+		return nil, fmt.Errorf("rlLearn: invalid JSON: %v", err)
+	}
+	switch {
+	case fb.Rewards != nil:
+		if len(fb.Rewards) > n {
+			return fb.Rewards[:n], nil
+		}
+		return fb.Rewards, nil
+	case fb.Chosen != nil:
+		base, decay := 1.0, 1.0
+		if fb.BaseReward != nil {
+			base = *fb.BaseReward
+		}
+		if fb.Decay != nil {
+			decay = *fb.Decay
+		}
+		rewards := make([]float64, min(len(fb.Chosen), n))
+		for i := range rewards {
+			if fb.Chosen[i] == 0 {
+				continue
+			}
+			pos := float64(i)
+			if i < len(fb.Positions) {
+				pos = fb.Positions[i]
+			}
+			rewards[i] = base * math.Pow(decay, pos)
+		}
+		return rewards, nil
+	case fb.Events != nil:
+		rewards := make([]float64, n)
+		for _, e := range fb.Events {
+			if e.Idx >= 0 && e.Idx < n {
+				rewards[e.Idx] = e.Reward
+			}
+		}
+		return rewards, nil
+	}
+	return nil, errors.New("rlLearn: feedback needs rewards, chosen or events")
+}
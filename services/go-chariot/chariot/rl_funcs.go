@@ -3,7 +3,8 @@
 // Provides Next-Best Action (NBA) scoring using the RL Support library (librl_support).
 // Features:
 // - LinUCB contextual bandit
-// - ONNX model inference (optional, graceful fallback to LinUCB)
+// - ONNX model inference (optional; the shipped libraries only apply a
+//   placeholder model_path bonus, real inference needs -DBUILD_ONNX=ON)
 // - Batch candidate scoring (<1ms latency)
 // - Online learning with structured feedback
 //
@@ -19,10 +20,17 @@ import (
 	"encoding/json"
 	"errors"
 	"fmt"
+	"sync"
+	"sync/atomic"
 )
 
 // RegisterRLFunctions registers RL support functions as closures
 func RegisterRLFunctions(rt *Runtime) {
+	registerRLBufferFunctions(rt)
+	registerRLSelectFunctions(rt)
+	registerRLSparseFunctions(rt)
+	registerRLSnapshotFunctions(rt)
+
 	// rlInit initializes an RL scorer from JSON configuration
 	//
 	// Chariot signature: rlInit(configJSON) -> rlHandle
@@ -32,7 +40,9 @@ func RegisterRLFunctions(rt *Runtime) {
 	//     "alpha": 0.3,                // LinUCB exploration parameter (required)
 	//     "model_path": "/models/nba.onnx",  // Optional: ONNX model path
 	//     "model_input": "input",      // Optional: ONNX input tensor name
-	//     "model_output": "output"     // Optional: ONNX output tensor name
+	//     "model_output": "output",    // Optional: ONNX output tensor name
+	//     "shards": 4,                 // Optional: library handles for concurrent scoring (default 1)
+	//     "covariance": "diagonal"     // Optional: "library" (default) or Go-side diagonal LinUCB
 	//   }
 	//
 	// Returns: RL scorer handle (opaque Value wrapping C handle) or error
@@ -80,14 +90,25 @@ func RegisterRLFunctions(rt *Runtime) {
 			return nil, fmt.Errorf("rlInit: config missing required field 'alpha'")
 		}
 
+		// shards is handled here; the library gets the rest of the config
+		shards := 1
+		if v, ok := configMap["shards"]; ok {
+			n, ok := v.(float64)
+			if !ok || n != float64(int(n)) || n < 1 || n > maxRLShards {
+				return nil, fmt.Errorf("rlInit: shards must be an integer 1-%d", maxRLShards)
+			}
+			shards = int(n)
+			delete(configMap, "shards")
+			data, _ := json.Marshal(configMap)
+			configJSON = string(data)
+		}
+
 		// Call platform-specific CGO implementation
-		handle, err := rlInit(configJSON)
+		handle, err := NewRLHandle(configJSON, shards)
 		if err != nil {
 			return nil, fmt.Errorf("rlInit: %w", err)
 		}
-
-		// Wrap handle in opaque Value
-		return &RLHandle{handle: handle}, nil
+		return handle, nil
 	})
 
 	// rlScore scores a batch of candidates using their feature vectors
@@ -104,78 +125,103 @@ func RegisterRLFunctions(rt *Runtime) {
 	//   setq(features, array(0.5, 0.3, 0.8, 1.0, 0.2, 0.9))  # 2 candidates, 3 features each
 	//   setq(scores, rlScore(rlHandle, features, 3))        # Returns array(0.72, 0.68)
 	rt.Register("rlScore", func(args ...Value) (Value, error) {
-		if len(args) != 3 {
-			return nil, errors.New("rlScore requires 3 arguments")
+		rlHandle, features, featDim, err := rlScoreArgs("rlScore", args)
+		if err != nil {
+			return nil, err
 		}
 
-		// Unwrap args if needed
-		for i, arg := range args {
-			if tvar, ok := arg.(ScopeEntry); ok {
-				args[i] = tvar.Value
-			}
+		// Call platform-specific CGO implementation
+		scores := make([]float64, len(features)/featDim)
+		if err := rlHandle.ScoreInto(features, featDim, scores); err != nil {
+			return nil, fmt.Errorf("rlScore: %w", err)
 		}
 
-		// Extract handle
-		rlHandle, ok := args[0].(*RLHandle)
-		if !ok {
-			return nil, fmt.Errorf("rlScore: first argument must be RL handle from rlInit, got %T", args[0])
+		// Convert scores to Chariot ArrayValue
+		result := make([]Value, len(scores))
+		for i, score := range scores {
+			result[i] = Number(score)
 		}
 
-		// Extract features array
-		featuresArr, ok := args[1].(*ArrayValue)
-		if !ok {
-			return nil, fmt.Errorf("rlScore: second argument must be array of features, got %T", args[1])
-		}
+		return &ArrayValue{Elements: result}, nil
+	})
 
-		// Convert to []float32
-		features := make([]float32, len(featuresArr.Elements))
-		for i, v := range featuresArr.Elements {
-			num, ok := v.(Number)
-			if !ok {
-				return nil, fmt.Errorf("rlScore: feature at index %d is not numeric, got %T", i, v)
-			}
-			features[i] = float32(num)
+	// rlScoreBatch scores like rlScore and also returns a batch token
+	//
+	// Chariot signature: rlScoreBatch(handle, featuresArray, featDim) -> map
+	//
+	// Returns: { "scores": [...], "token": n }. Pass the token to rlLearn to
+	// apply feedback to this batch, even after other batches were scored on
+	// the same handle. Required for learning on handles with shards > 1.
+	//
+	// Example:
+	//   setq(batch, rlScoreBatch(rlHandle, features, 3))
+	//   rlLearn(rlHandle, '{"rewards": [1.0, 0.0]}', getProp(batch, "token"))
+	rt.Register("rlScoreBatch", func(args ...Value) (Value, error) {
+		rlHandle, features, featDim, err := rlScoreArgs("rlScoreBatch", args)
+		if err != nil {
+			return nil, err
 		}
 
-		// Extract featDim
-		featDimNum, ok := args[2].(Number)
-		if !ok {
-			return nil, fmt.Errorf("rlScore: featDim must be integer, got %T", args[2])
+		scores := make([]float64, len(features)/featDim)
+		token, err := rlHandle.ScoreBatch(features, featDim, scores)
+		if err != nil {
+			return nil, fmt.Errorf("rlScoreBatch: %w", err)
 		}
-		featDim := int(featDimNum)
 
-		if featDim <= 0 {
-			return nil, fmt.Errorf("rlScore: featDim must be positive, got %d", featDim)
+		elems := make([]Value, len(scores))
+		for i, score := range scores {
+			elems[i] = Number(score)
 		}
+		result := NewMap()
+		result.Values["scores"] = NewArrayWithValues(elems)
+		result.Values["token"] = Number(token)
+		return result, nil
+	})
 
-		if len(features)%featDim != 0 {
-			return nil, fmt.Errorf("rlScore: features length %d not divisible by featDim %d", len(features), featDim)
+	// rlScoreInto scores into a caller-owned buffer with no conversion
+	//
+	// Chariot signature: rlScoreInto(handle, features, featDim, scores) -> scores
+	//
+	// features: float32Buffer (or numeric array) of numCandidates*featDim values
+	// scores: float64Buffer of numCandidates values, overwritten in place
+	//
+	// With buffers on both sides the features go to the library in place
+	// and scores are written straight into the buffer, so neither side is
+	// converted per element. Reuse both buffers across calls.
+	//
+	// Example:
+	//   setq(features, float32Buffer(mul(n, 32)))
+	//   setq(scores, float64Buffer(n))
+	//   rlScoreInto(rlHandle, features, 32, scores)
+	//   setq(best, bufferGet(scores, 0))
+	rt.Register("rlScoreInto", func(args ...Value) (Value, error) {
+		if len(args) != 4 {
+			return nil, errors.New("rlScoreInto requires 4 arguments")
+		}
+		rlHandle, features, featDim, err := rlScoreArgs("rlScoreInto", args[:3])
+		if err != nil {
+			return nil, err
 		}
-
-		// Convert float32 to float64 for CGO
-		features64 := make([]float64, len(features))
-		for i, f := range features {
-			features64[i] = float64(f)
+		out := args[3]
+		if tvar, ok := out.(ScopeEntry); ok {
+			out = tvar.Value
 		}
-
-		// Call platform-specific CGO implementation
-		scores, err := rlScore(rlHandle.handle, features64, featDim)
-		if err != nil {
-			return nil, fmt.Errorf("rlScore: %w", err)
+		scores, ok := out.(*Float64Buffer)
+		if !ok {
+			return nil, fmt.Errorf("rlScoreInto: fourth argument must be float64Buffer, got %T", out)
 		}
-
-		// Convert scores to Chariot ArrayValue
-		result := make([]Value, len(scores))
-		for i, score := range scores {
-			result[i] = Number(score)
+		if n := len(features) / featDim; len(scores.Data) != n {
+			return nil, fmt.Errorf("rlScoreInto: scores buffer length %d != candidates %d", len(scores.Data), n)
 		}
-
-		return &ArrayValue{Elements: result}, nil
+		if err := rlHandle.ScoreInto(features, featDim, scores.Data); err != nil {
+			return nil, fmt.Errorf("rlScoreInto: %w", err)
+		}
+		return scores, nil
 	})
 
 	// rlLearn updates the RL model with feedback (online learning)
 	//
-	// Chariot signature: rlLearn(handle, feedbackJSON) -> success
+	// Chariot signature: rlLearn(handle, feedbackJSON, [token]) -> success
 	//
 	// handle: RL scorer handle from rlInit
 	//
@@ -185,13 +231,16 @@ func RegisterRLFunctions(rt *Runtime) {
 	//     "decay": 0.95                  // Optional: reward decay factor
 	//   }
 	//
+	// token: Optional batch token from rlScoreBatch; without it the feedback
+	// applies to the handle's most recently scored batch
+	//
 	// Returns: true on success, error otherwise
 	//
 	// Example:
 	//   rlLearn(rlHandle, jsonParse('{"rewards": [0.8, 0.5, 0.3]}'))
 	rt.Register("rlLearn", func(args ...Value) (Value, error) {
-		if len(args) != 2 {
-			return nil, errors.New("rlLearn requires 2 arguments")
+		if len(args) < 2 || len(args) > 3 {
+			return nil, errors.New("rlLearn requires 2-3 arguments")
 		}
 
 		// Unwrap args if needed
@@ -234,8 +283,17 @@ func RegisterRLFunctions(rt *Runtime) {
 			return nil, fmt.Errorf("rlLearn: feedback missing required field 'rewards'")
 		}
 
+		var token uint64
+		if len(args) == 3 {
+			num, ok := args[2].(Number)
+			if !ok || num < 1 || num != Number(uint64(num)) {
+				return nil, fmt.Errorf("rlLearn: token must be a batch token from rlScoreBatch, got %v", args[2])
+			}
+			token = uint64(num)
+		}
+
 		// Call platform-specific CGO implementation
-		if err := rlLearn(rlHandle.handle, feedbackJSON); err != nil {
+		if err := rlHandle.Learn(feedbackJSON, token); err != nil {
 			return nil, fmt.Errorf("rlLearn: %w", err)
 		}
 
@@ -269,11 +327,8 @@ func RegisterRLFunctions(rt *Runtime) {
 			return nil, fmt.Errorf("rlClose: argument must be RL handle from rlInit, got %T", arg)
 		}
 
-		// Call platform-specific CGO implementation
-		rlClose(rlHandle.handle)
-
-		// Mark handle as closed to prevent reuse
-		rlHandle.handle = nil
+		// Release every shard and mark the handle closed to prevent reuse
+		rlHandle.Close()
 
 		return Bool(true), nil
 	})
@@ -596,10 +651,175 @@ func RegisterRLFunctions(rt *Runtime) {
 	})
 }
 
-// RLHandle wraps the platform-specific RL handle
-// This provides lifecycle management and prevents handle reuse after close
+// rlScoreArgs unwraps (handle, features, featDim) for rlScore, rlScoreBatch
+// and rlScoreInto, which checks its own argument count and passes the first
+// three. features is a numeric array or a float32Buffer.
+func rlScoreArgs(fn string, args []Value) (*RLHandle, []float32, int, error) {
+	if len(args) != 3 {
+		return nil, nil, 0, fmt.Errorf("%s requires 3 arguments", fn)
+	}
+
+	// Unwrap args if needed
+	for i, arg := range args {
+		if tvar, ok := arg.(ScopeEntry); ok {
+			args[i] = tvar.Value
+		}
+	}
+
+	// Extract handle
+	rlHandle, ok := args[0].(*RLHandle)
+	if !ok {
+		return nil, nil, 0, fmt.Errorf("%s: first argument must be RL handle from rlInit, got %T", fn, args[0])
+	}
+
+	// Extract features; a float32Buffer is passed through without a copy
+	var features []float32
+	switch v := args[1].(type) {
+	case *Float32Buffer:
+		features = v.Data
+	case *ArrayValue:
+		features = make([]float32, len(v.Elements))
+		for i, e := range v.Elements {
+			num, ok := e.(Number)
+			if !ok {
+				return nil, nil, 0, fmt.Errorf("%s: feature at index %d is not numeric, got %T", fn, i, e)
+			}
+			features[i] = float32(num)
+		}
+	default:
+		return nil, nil, 0, fmt.Errorf("%s: second argument must be array of features or float32Buffer, got %T", fn, args[1])
+	}
+
+	// Extract featDim
+	featDimNum, ok := args[2].(Number)
+	if !ok {
+		return nil, nil, 0, fmt.Errorf("%s: featDim must be integer, got %T", fn, args[2])
+	}
+	featDim := int(featDimNum)
+
+	if featDim <= 0 {
+		return nil, nil, 0, fmt.Errorf("%s: featDim must be positive, got %d", fn, featDim)
+	}
+
+	if len(features)%featDim != 0 {
+		return nil, nil, 0, fmt.Errorf("%s: features length %d not divisible by featDim %d", fn, len(features), featDim)
+	}
+
+	return rlHandle, features, featDim, nil
+}
+
+// RLHandle wraps one or more platform-specific RL handles ("shards"), or
+// a Go-side model (see rlDiagModel) for covariance "diagonal".
+//
+// A library handle keeps the last scored batch for rl_learn_batch, so it
+// can serve one caller at a time. With several shards, concurrent scorers
+// each lock a free shard instead of queueing on one. Every shard starts
+// from the same config and receives every model update, in the same order,
+// so all shards hold the same model. Updates for a scored batch are keyed
+// by the token ScoreBatch returns rather than by "the last batch": Learn
+// replays that batch's features on each shard before applying the
+// feedback, locking one shard at a time so the others keep scoring.
 type RLHandle struct {
-	handle interface{} // Platform-specific handle (C pointer on CGO builds, nil on stub)
+	shards   []*rlShard
+	diag     *rlDiagModel  // scores instead of shards when set
+	next     uint32        // round-robin start for scoring
+	closed   atomic.Bool   // set by close
+	learnMu  sync.Mutex    // orders model updates across shards
+	version  atomic.Uint64 // counts Learn and MergeDelta calls, see ModelVersion
+	diverged atomic.Bool   // set when an update reached only some shards
+
+	batchMu      sync.Mutex
+	batches      map[uint64]rlBatch
+	order        []uint64 // pending tokens, oldest first
+	pendingBytes int      // sum of size() over batches
+	lastToken    uint64
+}
+
+type rlShard struct {
+	mu     sync.Mutex
+	handle interface{} // platform handle; nil once closed
+}
+
+// rlBatch is a scored batch kept for a later Learn, with dense features
+// or, from ScoreSparseBatch, sparse ones.
+type rlBatch struct {
+	features []float32
+	sparse   *RLSparseBatch
+	featDim  int
+}
+
+// candidates returns the number of candidates in b.
+func (b rlBatch) candidates() int {
+	if b.sparse != nil {
+		return b.sparse.Candidates()
+	}
+	return len(b.features) / b.featDim
+}
+
+// size returns the bytes of feature data b holds.
+func (b rlBatch) size() int {
+	if b.sparse != nil {
+		return 4 * (len(b.sparse.Offsets) + len(b.sparse.Index) + len(b.sparse.Values))
+	}
+	return 4 * len(b.features)
+}
+
+// dense returns b's features as dense rows.
+func (b rlBatch) dense() []float32 {
+	if b.sparse == nil {
+		return b.features
+	}
+	n := b.sparse.Candidates()
+	features := make([]float32, n*b.featDim)
+	b.sparse.densify(0, n, b.featDim, features)
+	return features
+}
+
+const (
+	maxRLShards         = 64
+	rlMaxPendingBatches = 1024      // oldest batch tokens are dropped beyond this
+	rlMaxPendingBytes   = 256 << 20 // or once their features take more than this
+)
+
+// NewRLHandle creates an RL scorer from configJSON (see rlInit) backed by
+// shards library handles, for Go callers. Release it with Close.
+//
+// With "covariance": "diagonal" the model is kept in Go and shards is not
+// used: the model scores concurrently on its own.
+func NewRLHandle(configJSON string, shards int) (*RLHandle, error) {
+	if shards < 1 || shards > maxRLShards {
+		return nil, fmt.Errorf("shards must be an integer 1-%d", maxRLShards)
+	}
+	h := &RLHandle{batches: map[uint64]rlBatch{}}
+	var cfg RLConfig
+	if err := json.Unmarshal([]byte(configJSON), &cfg); err != nil {
+		return nil, fmt.Errorf("rlInit: invalid JSON: %v", err)
+	}
+	switch cfg.Covariance {
+	case "", rlCovarianceLibrary:
+	case rlCovarianceDiagonal:
+		switch {
+		case cfg.FeatDim <= 0:
+			return nil, errors.New("rlInit: feat_dim must be > 0")
+		case cfg.Alpha <= 0:
+			return nil, errors.New("rlInit: alpha must be > 0")
+		case cfg.ModelPath != "":
+			return nil, errors.New("rlInit: model_path needs covariance \"library\"")
+		}
+		h.diag = newRLDiagModel(cfg.FeatDim, cfg.Alpha)
+		return h, nil
+	default:
+		return nil, fmt.Errorf("rlInit: covariance must be %q or %q", rlCovarianceLibrary, rlCovarianceDiagonal)
+	}
+	for i := 0; i < shards; i++ {
+		handle, err := rlInit(configJSON)
+		if err != nil {
+			h.Close()
+			return nil, err
+		}
+		h.shards = append(h.shards, &rlShard{handle: handle})
+	}
+	return h, nil
 }
 
 // Type implements Value interface
@@ -609,17 +829,258 @@ func (h *RLHandle) Type() string {
 
 // String implements Value interface
 func (h *RLHandle) String() string {
-	if h.handle == nil {
+	if !h.ToBool() {
 		return "<RLHandle:closed>"
 	}
-	return fmt.Sprintf("<RLHandle:%p>", h.handle)
+	if h.diag != nil && h.diag.shared {
+		return fmt.Sprintf("<RLHandle:%p diagonal shared>", h.diag)
+	}
+	if h.diag != nil {
+		return fmt.Sprintf("<RLHandle:%p diagonal>", h.diag)
+	}
+	if len(h.shards) > 1 {
+		return fmt.Sprintf("<RLHandle:%p x%d>", h.shards[0], len(h.shards))
+	}
+	return fmt.Sprintf("<RLHandle:%p>", h.shards[0])
 }
 
 // ToBool implements Value interface
 func (h *RLHandle) ToBool() bool {
-	return h.handle != nil
+	return !h.closed.Load() && (len(h.shards) > 0 || h.diag != nil)
+}
+
+// FeatDim returns the feature dimension of the model, or -1 once closed.
+func (h *RLHandle) FeatDim() int {
+	if !h.ToBool() {
+		return -1
+	}
+	if h.diag != nil {
+		return h.diag.dim
+	}
+	s := h.acquire()
+	defer s.mu.Unlock()
+	if s.handle == nil {
+		return -1
+	}
+	return rlFeatDim(s.handle)
+}
+
+// acquire locks a shard for scoring, preferring one no other caller holds.
+func (h *RLHandle) acquire() *rlShard {
+	n := len(h.shards)
+	start := int(atomic.AddUint32(&h.next, 1) % uint32(n))
+	for i := 0; i < n; i++ {
+		if s := h.shards[(start+i)%n]; s.mu.TryLock() {
+			return s
+		}
+	}
+	s := h.shards[start]
+	s.mu.Lock()
+	return s
+}
+
+// ScoreInto scores len(out) candidates whose features are laid out
+// row-major in features (featDim per candidate), writing the scores to out.
+// Both slices are passed to the library in place, so a caller that reuses
+// its buffers scores with no allocation. Safe for concurrent use; callers
+// run in parallel up to the number of shards.
+func (h *RLHandle) ScoreInto(features []float32, featDim int, out []float64) error {
+	if err := h.check("rlScore"); err != nil {
+		return err
+	}
+	if h.diag != nil {
+		return h.scoreDiag(features, featDim, out)
+	}
+	s := h.acquire()
+	defer s.mu.Unlock()
+	if s.handle == nil {
+		return errors.New("rlScore: handle is closed")
+	}
+	return rlScore(s.handle, features, featDim, out)
+}
+
+// ScoreBatch is ScoreInto that also keeps a copy of features and returns a
+// token for Learn to apply feedback to exactly this batch.
+func (h *RLHandle) ScoreBatch(features []float32, featDim int, out []float64) (uint64, error) {
+	if err := h.ScoreInto(features, featDim, out); err != nil {
+		return 0, err
+	}
+	return h.storeBatch(append([]float32(nil), features...), featDim), nil
+}
+
+// scoreDiag is ScoreInto for covariance "diagonal", with the argument
+// checks the library makes for itself.
+func (h *RLHandle) scoreDiag(features []float32, featDim int, out []float64) error {
+	if d := h.diag.dim; featDim != d {
+		return fmt.Errorf("rlScore: featDim %d != feat_dim %d", featDim, d)
+	}
+	if len(features) == 0 || len(features)%featDim != 0 || len(out) != len(features)/featDim {
+		return fmt.Errorf("rlScore: %d scores for %d features of dimension %d", len(out), len(features), featDim)
+	}
+	return h.diag.scoreDense(features, out)
+}
+
+// storeBatch keeps features (owned by the handle from now on) for a later
+// Learn and returns their token.
+func (h *RLHandle) storeBatch(features []float32, featDim int) uint64 {
+	return h.keepBatch(rlBatch{features: features, featDim: featDim})
+}
+
+// storeSparseBatch is storeBatch for a sparse batch.
+func (h *RLHandle) storeSparseBatch(b *RLSparseBatch, featDim int) uint64 {
+	return h.keepBatch(rlBatch{sparse: b, featDim: featDim})
+}
+
+func (h *RLHandle) keepBatch(b rlBatch) uint64 {
+	h.batchMu.Lock()
+	defer h.batchMu.Unlock()
+	if h.batches == nil { // closed meanwhile
+		return 0
+	}
+	h.lastToken++
+	token := h.lastToken
+	h.batches[token] = b
+	h.order = append(h.order, token)
+	h.pendingBytes += b.size()
+	// The newest batch is kept even if it alone is over the byte limit.
+	for len(h.order) > rlMaxPendingBatches || (h.pendingBytes > rlMaxPendingBytes && len(h.order) > 1) {
+		h.pendingBytes -= h.batches[h.order[0]].size()
+		delete(h.batches, h.order[0])
+		h.order = h.order[1:]
+	}
+	return token
+}
+
+// Learn applies feedbackJSON (see rlLearn) to every shard. A token from
+// ScoreBatch selects the batch the feedback is for, and is consumed. Token
+// 0 means the handle's most recently scored batch, which is only defined
+// with a single shard of the library model.
+//
+// The feedback is checked before any shard learns from it. Should a shard
+// still fail after others have learned, the shards no longer hold the same
+// model and the handle refuses further scoring and learning; close it and
+// load the model again.
+func (h *RLHandle) Learn(feedbackJSON string, token uint64) error {
+	h.learnMu.Lock()
+	defer h.learnMu.Unlock()
+	defer h.version.Add(1)
+	if err := h.check("rlLearn"); err != nil {
+		return err
+	}
+
+	if token == 0 {
+		if h.diag != nil {
+			return errors.New("rlLearn: a batch token is required with covariance \"diagonal\"")
+		}
+		if len(h.shards) > 1 {
+			return errors.New("rlLearn: a batch token is required when the handle has more than one shard")
+		}
+		s := h.shards[0]
+		s.mu.Lock()
+		defer s.mu.Unlock()
+		return rlLearn(s.handle, feedbackJSON)
+	}
+
+	b, ok := h.takeBatch(token)
+	if !ok {
+		return fmt.Errorf("rlLearn: unknown or expired batch token %d", token)
+	}
+	if h.diag != nil {
+		rewards, err := rlFeedbackRewards(feedbackJSON, b.candidates())
+		if err != nil {
+			return err
+		}
+		return h.diag.learn(b, rewards)
+	}
+
+	if _, err := rlFeedbackRewards(feedbackJSON, b.candidates()); err != nil {
+		return err
+	}
+	features := b.dense()
+	scratch := make([]float64, len(features)/b.featDim)
+	for i, s := range h.shards {
+		s.mu.Lock()
+		err := rlScore(s.handle, features, b.featDim, scratch)
+		if err == nil {
+			err = rlLearn(s.handle, feedbackJSON)
+		}
+		s.mu.Unlock()
+		if err != nil {
+			if i > 0 {
+				h.diverged.Store(true)
+			}
+			return err
+		}
+	}
+	return nil
 }
 
+// check reports why h can't score or learn: it is closed, or a failed
+// Learn left its shards with different models.
+func (h *RLHandle) check(fn string) error {
+	if !h.ToBool() {
+		return fmt.Errorf("%s: handle is closed", fn)
+	}
+	if h.diverged.Load() {
+		return fmt.Errorf("%s: a failed update left the handle's shards inconsistent; close it and load the model again", fn)
+	}
+	return nil
+}
+
+// ModelVersion changes whenever the model may have changed (each Learn
+// and MergeDelta), so scores cached at one version are current as long as
+// it stays the same.
+func (h *RLHandle) ModelVersion() uint64 {
+	return h.version.Load()
+}
+
+// takeBatch removes and returns the batch stored under token.
+func (h *RLHandle) takeBatch(token uint64) (rlBatch, bool) {
+	h.batchMu.Lock()
+	defer h.batchMu.Unlock()
+	b, ok := h.batches[token]
+	if ok {
+		delete(h.batches, token)
+		h.pendingBytes -= b.size()
+		for i, t := range h.order {
+			if t == token {
+				h.order = append(h.order[:i], h.order[i+1:]...)
+				break
+			}
+		}
+	}
+	return b, ok
+}
+
+// Close releases every shard. Further calls fail with "handle is closed".
+func (h *RLHandle) Close() {
+	h.learnMu.Lock()
+	defer h.learnMu.Unlock()
+	h.closed.Store(true)
+	if h.diag != nil {
+		h.diag.close()
+	}
+	for _, s := range h.shards {
+		s.mu.Lock()
+		if s.handle != nil {
+			rlClose(s.handle)
+			s.handle = nil
+		}
+		s.mu.Unlock()
+	}
+	h.batchMu.Lock()
+	h.batches = nil
+	h.order = nil
+	h.pendingBytes = 0
+	h.batchMu.Unlock()
+}
+
+// rlErrLen is the size of the error buffer handed to the C API.
+const rlErrLen = 512
+
+// rlErrBufPool recycles C API error buffers across calls.
+var rlErrBufPool = sync.Pool{New: func() interface{} { return new([rlErrLen]byte) }}
+
 // Platform-specific CGO implementations (provided by build-tag gated files)
 // These are implemented in:
 // - rl_cgo_darwin_cpu.go (darwin && arm64 && cgo)
@@ -633,9 +1094,21 @@ func rlInit(configJSON string) (interface{}, error) {
 	return rlInit_impl(configJSON)
 }
 
-// rlScore scores candidates using feature vectors, returns array of scores
-func rlScore(handle interface{}, features []float64, featDim int) ([]float64, error) {
-	return rlScore_impl(handle, features, featDim)
+// rlScore scores candidates using feature vectors, writing one score per
+// candidate into out
+func rlScore(handle interface{}, features []float32, featDim int, out []float64) error {
+	return rlScore_impl(handle, features, featDim, out)
+}
+
+// rlPrepare computes select-mode features for masks (numItems bytes per
+// candidate) into features
+func rlPrepare(handle interface{}, masks []byte, numItems int, features []float32) error {
+	return rlPrepare_impl(handle, masks, numItems, features)
+}
+
+// rlFeatDim returns the library's feature dimension, or -1
+func rlFeatDim(handle interface{}) int {
+	return rlFeatDim_impl(handle)
 }
 
 // rlLearn updates model with feedback JSON
@@ -0,0 +1,359 @@
+package chariot
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"sort"
+)
+
+// RLRetainAll keeps the features of every candidate for Learn.
+const RLRetainAll = -1
+
+// rlSelectTileBytes bounds the feature tile of ScoreSelect when no tile
+// size is given: small enough to stay in L2 between preparing and scoring.
+const rlSelectTileBytes = 256 << 10
+
+// RLSelectOptions controls RLHandle.ScoreSelect.
+type RLSelectOptions struct {
+	// Tile is the number of candidates prepared and scored at a time; 0
+	// sizes the tile to rlSelectTileBytes of features.
+	Tile int
+	// Retain is how many candidates keep their features for Learn: 0
+	// none, k > 0 the k best scored, RLRetainAll every candidate.
+	Retain int
+}
+
+// RLSelectResult describes the candidates ScoreSelect retained for Learn.
+type RLSelectResult struct {
+	Token    uint64 // batch token for Learn; 0 when nothing was retained
+	Retained []int  // retained candidates, ascending; feedback indexes this list
+}
+
+// ScoreSelect scores select-mode candidates given as 0/1 masks, numItems
+// bytes per candidate, writing one score per candidate to out.
+//
+// Features are computed by the library a tile at a time and scored while
+// still in cache, so the full candidates x feat_dim matrix is never built
+// and memory stays bounded by the tile and the retained candidates. The
+// retained features are stored as a batch (see ScoreBatch); the returned
+// token applies feedback to them, with rewards given in Retained order.
+// Without retention the batch cannot be learned from.
+func (h *RLHandle) ScoreSelect(masks []byte, numItems int, out []float64, opts RLSelectOptions) (RLSelectResult, error) {
+	var res RLSelectResult
+	if err := h.check("rlScoreSelect"); err != nil {
+		return res, err
+	}
+	if numItems <= 0 || len(masks)%numItems != 0 {
+		return res, fmt.Errorf("rlScoreSelect: masks length %d not a multiple of numItems %d", len(masks), numItems)
+	}
+	n := len(masks) / numItems
+	if n == 0 {
+		return res, errors.New("rlScoreSelect: no candidates")
+	}
+	if len(out) != n {
+		return res, fmt.Errorf("rlScoreSelect: %d scores for %d candidates", len(out), n)
+	}
+	if opts.Tile < 0 || opts.Retain < RLRetainAll {
+		return res, errors.New("rlScoreSelect: tile and retain must be >= 0")
+	}
+	if h.diag != nil {
+		return res, errors.New("rlScoreSelect: select-mode features need covariance \"library\"")
+	}
+
+	s := h.acquire()
+	defer s.mu.Unlock()
+	if s.handle == nil {
+		return res, errors.New("rlScoreSelect: handle is closed")
+	}
+	featDim := rlFeatDim(s.handle)
+	if featDim <= 0 {
+		return res, errors.New("rlScoreSelect: invalid handle")
+	}
+
+	tile := opts.Tile
+	if tile == 0 {
+		tile = rlSelectTileBytes / (4 * featDim)
+		if tile < 1 {
+			tile = 1
+		}
+	}
+	if tile > n {
+		tile = n
+	}
+	retain := opts.Retain
+	if retain == RLRetainAll || retain > n {
+		retain = n
+	}
+
+	buf := make([]float32, tile*featDim)
+	keep := newRLRetained(retain, featDim)
+	for start := 0; start < n; start += tile {
+		end := start + tile
+		if end > n {
+			end = n
+		}
+		feats := buf[:(end-start)*featDim]
+		if err := rlPrepare(s.handle, masks[start*numItems:end*numItems], numItems, feats); err != nil {
+			return res, fmt.Errorf("rlScoreSelect: %w", err)
+		}
+		if err := rlScore(s.handle, feats, featDim, out[start:end]); err != nil {
+			return res, fmt.Errorf("rlScoreSelect: %w", err)
+		}
+		for i := start; i < end; i++ {
+			keep.offer(i, out[i], feats[(i-start)*featDim:(i-start+1)*featDim])
+		}
+	}
+	if retain == 0 {
+		return res, nil
+	}
+
+	features, retained := keep.sorted()
+	res.Retained = retained
+	res.Token = h.storeBatch(features, featDim)
+	return res, nil
+}
+
+// rlRetained keeps the features of the k best-scored candidates offered,
+// in a min-heap on score so each offer costs O(log k).
+type rlRetained struct {
+	k, featDim int
+	heap       []int // slots, lowest score first
+	index      []int // slot -> candidate
+	score      []float64
+	features   []float32 // slot-major, featDim per slot
+}
+
+func newRLRetained(k, featDim int) *rlRetained {
+	return &rlRetained{
+		k:        k,
+		featDim:  featDim,
+		heap:     make([]int, 0, k),
+		index:    make([]int, 0, k),
+		score:    make([]float64, 0, k),
+		features: make([]float32, 0, k*featDim),
+	}
+}
+
+func (r *rlRetained) offer(candidate int, score float64, features []float32) {
+	if r.k == 0 {
+		return
+	}
+	if len(r.heap) < r.k {
+		slot := len(r.index)
+		r.index = append(r.index, candidate)
+		r.score = append(r.score, score)
+		r.features = append(r.features, features...)
+		r.heap = append(r.heap, slot)
+		r.up(len(r.heap) - 1)
+		return
+	}
+	slot := r.heap[0]
+	if score <= r.score[slot] {
+		return
+	}
+	r.index[slot], r.score[slot] = candidate, score
+	copy(r.features[slot*r.featDim:], features)
+	r.down(0)
+}
+
+func (r *rlRetained) less(a, b int) bool {
+	return r.score[r.heap[a]] < r.score[r.heap[b]]
+}
+
+func (r *rlRetained) up(i int) {
+	for i > 0 {
+		parent := (i - 1) / 2
+		if !r.less(i, parent) {
+			return
+		}
+		r.heap[i], r.heap[parent] = r.heap[parent], r.heap[i]
+		i = parent
+	}
+}
+
+func (r *rlRetained) down(i int) {
+	for {
+		least := i
+		for _, c := range []int{2*i + 1, 2*i + 2} {
+			if c < len(r.heap) && r.less(c, least) {
+				least = c
+			}
+		}
+		if least == i {
+			return
+		}
+		r.heap[i], r.heap[least] = r.heap[least], r.heap[i]
+		i = least
+	}
+}
+
+// sorted returns the retained features and candidates in candidate order.
+func (r *rlRetained) sorted() ([]float32, []int) {
+	slots := make([]int, len(r.index))
+	for i := range slots {
+		slots[i] = i
+	}
+	sort.Slice(slots, func(a, b int) bool { return r.index[slots[a]] < r.index[slots[b]] })
+	features := make([]float32, 0, len(slots)*r.featDim)
+	candidates := make([]int, len(slots))
+	for i, slot := range slots {
+		features = append(features, r.features[slot*r.featDim:(slot+1)*r.featDim]...)
+		candidates[i] = r.index[slot]
+	}
+	return features, candidates
+}
+
+// registerRLSelectFunctions registers rlScoreSelect.
+func registerRLSelectFunctions(rt *Runtime) {
+	// rlScoreSelect scores select-mode candidates from their item masks
+	//
+	// Chariot signature: rlScoreSelect(handle, candidates, [optionsJSON]) -> map
+	//
+	// candidates: Array of candidates, each an Array of 0/1 per item
+	//
+	//   optionsJSON: {
+	//     "tile": 256,     // Optional: candidates per tile (default sized to cache)
+	//     "retain": 16     // Optional: candidates kept for rlLearn: 0 (default), k best, or "all"
+	//   }
+	//
+	// Returns: { "scores": [...], "retained": [...], "token": n }. retained
+	// and token are present when candidates were retained; rewards passed
+	// to rlLearn with the token follow the order of retained.
+	//
+	// Example:
+	//   setq(r, rlScoreSelect(rlHandle, candidates, '{"retain": 8}'))
+	//   rlLearn(rlHandle, '{"rewards": [1, 0, 0, 0, 0, 0, 0, 0]}', getProp(r, "token"))
+	rt.Register("rlScoreSelect", func(args ...Value) (Value, error) {
+		if len(args) < 2 || len(args) > 3 {
+			return nil, errors.New("rlScoreSelect requires 2-3 arguments")
+		}
+		for i, arg := range args {
+			if tvar, ok := arg.(ScopeEntry); ok {
+				args[i] = tvar.Value
+			}
+		}
+
+		rlHandle, ok := args[0].(*RLHandle)
+		if !ok {
+			return nil, fmt.Errorf("rlScoreSelect: first argument must be RL handle from rlInit, got %T", args[0])
+		}
+		masks, numItems, err := rlSelectMasks(args[1])
+		if err != nil {
+			return nil, err
+		}
+		var opts RLSelectOptions
+		if len(args) == 3 {
+			if opts, err = parseRLSelectOptions(args[2]); err != nil {
+				return nil, err
+			}
+		}
+
+		scores := make([]float64, len(masks)/numItems)
+		res, err := rlHandle.ScoreSelect(masks, numItems, scores, opts)
+		if err != nil {
+			return nil, err
+		}
+
+		elems := make([]Value, len(scores))
+		for i, score := range scores {
+			elems[i] = Number(score)
+		}
+		result := NewMap()
+		result.Values["scores"] = NewArrayWithValues(elems)
+		if res.Token != 0 {
+			retained := make([]Value, len(res.Retained))
+			for i, c := range res.Retained {
+				retained[i] = Number(c)
+			}
+			result.Values["retained"] = NewArrayWithValues(retained)
+			result.Values["token"] = Number(res.Token)
+		}
+		return result, nil
+	})
+}
+
+// rlSelectMasks flattens an Array of 0/1 Arrays into candidate-major bytes.
+func rlSelectMasks(arg Value) ([]byte, int, error) {
+	arr, ok := arg.(*ArrayValue)
+	if !ok || len(arr.Elements) == 0 {
+		return nil, 0, fmt.Errorf("rlScoreSelect: candidates must be a non-empty array of arrays, got %T", arg)
+	}
+	numItems := 0
+	var masks []byte
+	for c, v := range arr.Elements {
+		if tvar, ok := v.(ScopeEntry); ok {
+			v = tvar.Value
+		}
+		row, ok := v.(*ArrayValue)
+		if !ok {
+			return nil, 0, fmt.Errorf("rlScoreSelect: candidate %d is not an array, got %T", c, v)
+		}
+		if c == 0 {
+			numItems = len(row.Elements)
+			if numItems == 0 {
+				return nil, 0, errors.New("rlScoreSelect: candidates have no items")
+			}
+			masks = make([]byte, 0, len(arr.Elements)*numItems)
+		} else if len(row.Elements) != numItems {
+			return nil, 0, fmt.Errorf("rlScoreSelect: candidate %d has %d items, want %d", c, len(row.Elements), numItems)
+		}
+		for _, e := range row.Elements {
+			num, ok := e.(Number)
+			if !ok {
+				return nil, 0, fmt.Errorf("rlScoreSelect: candidate %d has a non-numeric item, got %T", c, e)
+			}
+			if num != 0 {
+				masks = append(masks, 1)
+			} else {
+				masks = append(masks, 0)
+			}
+		}
+	}
+	return masks, numItems, nil
+}
+
+// parseRLSelectOptions reads rlScoreSelect options from a string or JSONNode.
+func parseRLSelectOptions(arg Value) (RLSelectOptions, error) {
+	var opts RLSelectOptions
+	var optionsJSON string
+	switch v := arg.(type) {
+	case Str:
+		optionsJSON = string(v)
+	case *JSONNode:
+		data, err := v.ToJSON()
+		if err != nil {
+			return opts, fmt.Errorf("rlScoreSelect: failed to serialize options JSONNode: %w", err)
+		}
+		optionsJSON = string(data)
+	default:
+		return opts, fmt.Errorf("rlScoreSelect: options must be string or JSONNode, got %T", arg)
+	}
+
+	var raw struct {
+		Tile   *float64        `json:"tile"`
+		Retain json.RawMessage `json:"retain"`
+	}
+	if err := json.Unmarshal([]byte(optionsJSON), &raw); err != nil {
+		return opts, fmt.Errorf("rlScoreSelect: invalid options JSON: %w", err)
+	}
+	if raw.Tile != nil {
+		if *raw.Tile < 1 || *raw.Tile != float64(int(*raw.Tile)) {
+			return opts, errors.New("rlScoreSelect: tile must be a positive integer")
+		}
+		opts.Tile = int(*raw.Tile)
+	}
+	if len(raw.Retain) > 0 {
+		var all string
+		var k float64
+		switch {
+		case json.Unmarshal(raw.Retain, &all) == nil && all == "all":
+			opts.Retain = RLRetainAll
+		case json.Unmarshal(raw.Retain, &k) == nil && k >= 0 && k == float64(int(k)):
+			opts.Retain = int(k)
+		default:
+			return opts, errors.New(`rlScoreSelect: retain must be a non-negative integer or "all"`)
+		}
+	}
+	return opts, nil
+}
@@ -0,0 +1,545 @@
+package chariot
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"math"
+	"os"
+	"path/filepath"
+	"sort"
+	"unsafe"
+)
+
+// RL snapshots hold a covariance "diagonal" model (see rlDiagModel) so a
+// learned model survives rlClose and restarts, and so many processes can
+// score from one copy in the page cache.
+//
+// Snapshot layout (all values little-endian):
+//
+//	header 32 bytes  magic "CHRLSNAP", version u32, model u32 (1 = diagonal),
+//	                 feat_dim u64, alpha f64
+//	a      feat_dim x f64, ridge terms
+//	b      feat_dim x f64, reward sums
+//	crc    u32, CRC-32 (IEEE) of everything before it
+//
+// Deltas carry what a handle learned, as increments to a and b, so deltas
+// from any number of nodes add up to the model they would have learned
+// together:
+//
+//	header 32 bytes  magic "CHRLDLTA", version u32, model u32, feat_dim u64,
+//	                 entry count u64
+//	entry  20 bytes  feature index u32, a increment f64, b increment f64
+//	crc    u32, as above
+//
+// Version 1 held a, b and the increments as f32 (12-byte delta entries).
+// Both kinds are still read; a version 1 snapshot is always copied, since
+// its values can't be scored from in place.
+const (
+	rlSnapMagic         = "CHRLSNAP"
+	rlDeltaMagic        = "CHRLDLTA"
+	rlSnapVersion       = 2
+	rlSnapModelDiagonal = 1
+	rlSnapHeaderSize    = 32
+	rlDeltaEntrySize    = 20
+)
+
+// rlDiagStat is one feature's ridge term and reward sum, or increments to
+// them.
+type rlDiagStat struct {
+	a, b float64
+}
+
+// putRLHeader writes a snapshot or delta header into buf.
+func putRLHeader(buf []byte, magic string, dim int, last uint64) {
+	copy(buf, magic)
+	binary.LittleEndian.PutUint32(buf[8:], rlSnapVersion)
+	binary.LittleEndian.PutUint32(buf[12:], rlSnapModelDiagonal)
+	binary.LittleEndian.PutUint64(buf[16:], uint64(dim))
+	binary.LittleEndian.PutUint64(buf[24:], last)
+}
+
+// parseRLHeader validates the header and checksum of a snapshot or delta
+// and returns its version, feature dimension and last header field.
+func parseRLHeader(data []byte, magic string) (uint32, int, uint64, error) {
+	if len(data) < rlSnapHeaderSize+4 || string(data[:8]) != magic {
+		return 0, 0, 0, errors.New("not an RL snapshot or delta of this kind")
+	}
+	v := binary.LittleEndian.Uint32(data[8:])
+	if v != 1 && v != rlSnapVersion {
+		return 0, 0, 0, fmt.Errorf("unsupported version %d", v)
+	}
+	if m := binary.LittleEndian.Uint32(data[12:]); m != rlSnapModelDiagonal {
+		return 0, 0, 0, fmt.Errorf("unsupported model %d", m)
+	}
+	body := len(data) - 4
+	if crc32.ChecksumIEEE(data[:body]) != binary.LittleEndian.Uint32(data[body:]) {
+		return 0, 0, 0, errors.New("checksum mismatch")
+	}
+	dim := binary.LittleEndian.Uint64(data[16:])
+	if dim == 0 || dim > math.MaxInt32 {
+		return 0, 0, 0, fmt.Errorf("feat_dim %d out of range", dim)
+	}
+	return v, int(dim), binary.LittleEndian.Uint64(data[24:]), nil
+}
+
+// rlStatWidth is the byte size of one statistic in a version v snapshot
+// or delta.
+func rlStatWidth(v uint32) int {
+	if v == 1 {
+		return 4
+	}
+	return 8
+}
+
+// rlStat decodes a statistic of width w (see rlStatWidth) from b.
+func rlStat(b []byte, w int) float64 {
+	if w == 4 {
+		return float64(math.Float32frombits(binary.LittleEndian.Uint32(b)))
+	}
+	return math.Float64frombits(binary.LittleEndian.Uint64(b))
+}
+
+// snapshot encodes the model.
+func (m *rlDiagModel) snapshot() ([]byte, error) {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.a == nil {
+		return nil, errors.New("rlSave: handle is closed")
+	}
+	d := m.dim
+	buf := make([]byte, rlSnapHeaderSize+16*d+4)
+	putRLHeader(buf, rlSnapMagic, d, math.Float64bits(m.alpha))
+	as, bs := buf[rlSnapHeaderSize:], buf[rlSnapHeaderSize+8*d:]
+	for i := 0; i < d; i++ {
+		st := m.stat(i)
+		binary.LittleEndian.PutUint64(as[8*i:], math.Float64bits(st.a))
+		binary.LittleEndian.PutUint64(bs[8*i:], math.Float64bits(st.b))
+	}
+	body := len(buf) - 4
+	binary.LittleEndian.PutUint32(buf[body:], crc32.ChecksumIEEE(buf[:body]))
+	return buf, nil
+}
+
+// newRLDiagSnapshot decodes a snapshot. With mapped set, data is a
+// read-only mapping that the model scores from in place; it is unmapped
+// when the model is closed, or here for a version 1 snapshot, which is
+// copied. Otherwise the state is copied out of data.
+func newRLDiagSnapshot(data []byte, mapped bool) (*rlDiagModel, error) {
+	v, d, alphaBits, err := parseRLHeader(data, rlSnapMagic)
+	if err != nil {
+		return nil, err
+	}
+	w := rlStatWidth(v)
+	if len(data) != rlSnapHeaderSize+2*w*d+4 {
+		return nil, fmt.Errorf("size %d does not match feat_dim %d", len(data), d)
+	}
+	alpha := math.Float64frombits(alphaBits)
+	if !(alpha > 0) || math.IsInf(alpha, 0) {
+		return nil, errors.New("alpha must be > 0")
+	}
+	as, bs := data[rlSnapHeaderSize:], data[rlSnapHeaderSize+w*d:]
+	m := &rlDiagModel{dim: d, alpha: alpha}
+	if mapped && v == rlSnapVersion {
+		// The mapping is page-aligned and the header 32 bytes, so both
+		// arrays are 8-byte aligned.
+		m.shared, m.mapped = true, data
+		m.a = unsafe.Slice((*float64)(unsafe.Pointer(&as[0])), d)
+		m.b = unsafe.Slice((*float64)(unsafe.Pointer(&bs[0])), d)
+		m.local = map[int32]rlDiagStat{}
+		return m, nil
+	}
+	m.a, m.b = make([]float64, d), make([]float64, d)
+	for i := 0; i < d; i++ {
+		m.a[i] = rlStat(as[w*i:], w)
+		m.b[i] = rlStat(bs[w*i:], w)
+	}
+	if mapped {
+		munmapFile(data)
+	}
+	return m, nil
+}
+
+// trackDeltas starts recording what the model learns, if it isn't already.
+func (m *rlDiagModel) trackDeltas() error {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.a == nil {
+		return errors.New("rlTrackDeltas: handle is closed")
+	}
+	if m.pend == nil {
+		m.pend = map[int32]rlDiagStat{}
+	}
+	return nil
+}
+
+// takeDelta encodes what the model has learned since tracking started or
+// the last delta was taken, passes it to keep, and clears what was encoded
+// only if keep succeeds. Learning continues while keep runs; what it adds
+// stays pending for the next delta.
+func (m *rlDiagModel) takeDelta(keep func([]byte) error) ([]byte, int, error) {
+	m.deltaMu.Lock()
+	defer m.deltaMu.Unlock()
+	buf, count, err := m.encodeDelta()
+	if err != nil {
+		return nil, 0, err
+	}
+	if err := keep(buf); err != nil {
+		return nil, 0, err
+	}
+	m.commitDelta(buf)
+	return buf, count, nil
+}
+
+// encodeDelta encodes pend as a delta without clearing it.
+func (m *rlDiagModel) encodeDelta() ([]byte, int, error) {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.a == nil {
+		return nil, 0, errors.New("rlTakeDelta: handle is closed")
+	}
+	if m.pend == nil {
+		return nil, 0, errors.New("rlTakeDelta: the handle is not tracking deltas (see rlTrackDeltas)")
+	}
+	index := make([]int32, 0, len(m.pend))
+	for i := range m.pend {
+		index = append(index, i)
+	}
+	sort.Slice(index, func(x, y int) bool { return index[x] < index[y] })
+	buf := make([]byte, rlSnapHeaderSize+rlDeltaEntrySize*len(index)+4)
+	putRLHeader(buf, rlDeltaMagic, m.dim, uint64(len(index)))
+	for k, i := range index {
+		e, st := buf[rlSnapHeaderSize+rlDeltaEntrySize*k:], m.pend[i]
+		binary.LittleEndian.PutUint32(e, uint32(i))
+		binary.LittleEndian.PutUint64(e[4:], math.Float64bits(st.a))
+		binary.LittleEndian.PutUint64(e[12:], math.Float64bits(st.b))
+	}
+	body := len(buf) - 4
+	binary.LittleEndian.PutUint32(buf[body:], crc32.ChecksumIEEE(buf[:body]))
+	return buf, len(index), nil
+}
+
+// commitDelta takes the increments of delta, from encodeDelta, out of
+// pend. A feature that learned nothing since drops out of pend.
+func (m *rlDiagModel) commitDelta(delta []byte) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.pend == nil {
+		return
+	}
+	entries := delta[rlSnapHeaderSize : len(delta)-4]
+	for k := 0; k < len(entries); k += rlDeltaEntrySize {
+		i := int32(binary.LittleEndian.Uint32(entries[k:]))
+		p := m.pend[i]
+		p.a -= math.Float64frombits(binary.LittleEndian.Uint64(entries[k+4:]))
+		p.b -= math.Float64frombits(binary.LittleEndian.Uint64(entries[k+12:]))
+		if p.a == 0 && p.b == 0 {
+			delete(m.pend, i)
+		} else {
+			m.pend[i] = p
+		}
+	}
+}
+
+// mergeDelta adds a delta from takeDelta into the model. The delta is
+// validated in full before any of it is applied.
+func (m *rlDiagModel) mergeDelta(delta []byte) error {
+	v, d, count, err := parseRLHeader(delta, rlDeltaMagic)
+	if err != nil {
+		return fmt.Errorf("rlMergeDelta: %w", err)
+	}
+	if d != m.dim {
+		return fmt.Errorf("rlMergeDelta: delta has feat_dim %d, handle has %d", d, m.dim)
+	}
+	w := rlStatWidth(v)
+	size := uint64(4 + 2*w)
+	if count > uint64(d) || uint64(len(delta)) != rlSnapHeaderSize+size*count+4 {
+		return errors.New("rlMergeDelta: entry count does not match size")
+	}
+	entries := delta[rlSnapHeaderSize : len(delta)-4]
+	for k := 0; k < len(entries); k += int(size) {
+		da, db := rlStat(entries[k+4:], w), rlStat(entries[k+4+w:], w)
+		if binary.LittleEndian.Uint32(entries[k:]) >= uint32(d) || !(da >= 0) || math.IsInf(da, 0) || math.IsNaN(db) || math.IsInf(db, 0) {
+			return fmt.Errorf("rlMergeDelta: invalid entry %d", k/int(size))
+		}
+	}
+
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.a == nil {
+		return errors.New("rlMergeDelta: handle is closed")
+	}
+	for k := 0; k < len(entries); k += int(size) {
+		m.add(int32(binary.LittleEndian.Uint32(entries[k:])), rlStat(entries[k+4:], w), rlStat(entries[k+4+w:], w))
+	}
+	return nil
+}
+
+// Snapshot returns the model of a covariance "diagonal" handle in the
+// snapshot format above. Library handles expose no model state to save.
+func (h *RLHandle) Snapshot() ([]byte, error) {
+	if !h.ToBool() {
+		return nil, errors.New("rlSave: handle is closed")
+	}
+	if h.diag == nil {
+		return nil, errors.New("rlSave: only covariance \"diagonal\" handles can be saved; the RL library exposes no model state")
+	}
+	return h.diag.snapshot()
+}
+
+// WriteSnapshot writes Snapshot to path. The file is written next to path
+// and renamed into place, so processes sharing the old file keep a
+// consistent mapping.
+func (h *RLHandle) WriteSnapshot(path string) error {
+	data, err := h.Snapshot()
+	if err != nil {
+		return err
+	}
+	return rlWriteFile("rlSave", path, data)
+}
+
+// NewRLHandleFromSnapshot creates a covariance "diagonal" handle holding a
+// copy of the model in data, as from Snapshot.
+func NewRLHandleFromSnapshot(data []byte) (*RLHandle, error) {
+	m, err := newRLDiagSnapshot(data, false)
+	if err != nil {
+		return nil, fmt.Errorf("rlLoad: %w", err)
+	}
+	return &RLHandle{diag: m, batches: map[uint64]rlBatch{}}, nil
+}
+
+// OpenRLSnapshot loads the snapshot file at path. With shared set, the file
+// is mapped read-only and scored from in place, so every process opening
+// it shares one copy in the page cache; updates learned or merged into the
+// handle are kept privately, per feature, on top of the mapping. Otherwise
+// the model is copied into memory.
+func OpenRLSnapshot(path string, shared bool) (*RLHandle, error) {
+	if !shared || !hostLittleEndian {
+		data, err := os.ReadFile(path)
+		if err != nil {
+			return nil, fmt.Errorf("rlLoad: %w", err)
+		}
+		return NewRLHandleFromSnapshot(data)
+	}
+	data, err := mmapFile(path)
+	if err != nil {
+		return nil, fmt.Errorf("rlLoad: %w", err)
+	}
+	m, err := newRLDiagSnapshot(data, true)
+	if err != nil {
+		munmapFile(data)
+		return nil, fmt.Errorf("rlLoad: %s: %w", path, err)
+	}
+	return &RLHandle{diag: m, batches: map[uint64]rlBatch{}}, nil
+}
+
+// TrackDeltas makes the handle record what it learns from now on, for
+// TakeDelta. Handles don't track by default, since what a handle has
+// learned is kept twice until it is taken.
+func (h *RLHandle) TrackDeltas() error {
+	if !h.ToBool() {
+		return errors.New("rlTrackDeltas: handle is closed")
+	}
+	if h.diag == nil {
+		return errors.New("rlTrackDeltas: only covariance \"diagonal\" handles have deltas")
+	}
+	return h.diag.trackDeltas()
+}
+
+// TakeDelta returns what the handle has learned (through Learn, not
+// MergeDelta) since TrackDeltas or the last TakeDelta, and clears it. The
+// second result is the number of features in the delta.
+func (h *RLHandle) TakeDelta() ([]byte, int, error) {
+	if err := h.checkDelta("rlTakeDelta"); err != nil {
+		return nil, 0, err
+	}
+	return h.diag.takeDelta(func([]byte) error { return nil })
+}
+
+// WriteDelta writes TakeDelta to path as rlWriteFile does. What it wrote
+// is cleared only once the file is in place, so a failed write loses
+// nothing; it returns the number of features in the delta.
+func (h *RLHandle) WriteDelta(path string) (int, error) {
+	if err := h.checkDelta("rlTakeDelta"); err != nil {
+		return 0, err
+	}
+	_, count, err := h.diag.takeDelta(func(delta []byte) error {
+		return rlWriteFile("rlTakeDelta", path, delta)
+	})
+	return count, err
+}
+
+func (h *RLHandle) checkDelta(fn string) error {
+	if !h.ToBool() {
+		return fmt.Errorf("%s: handle is closed", fn)
+	}
+	if h.diag == nil {
+		return fmt.Errorf("%s: only covariance \"diagonal\" handles have deltas", fn)
+	}
+	return nil
+}
+
+// MergeDelta adds a delta from TakeDelta, typically from another process
+// or node, to the handle's model.
+func (h *RLHandle) MergeDelta(delta []byte) error {
+	if !h.ToBool() {
+		return errors.New("rlMergeDelta: handle is closed")
+	}
+	if h.diag == nil {
+		return errors.New("rlMergeDelta: only covariance \"diagonal\" handles have deltas")
+	}
+	defer h.version.Add(1)
+	return h.diag.mergeDelta(delta)
+}
+
+// rlWriteFile writes data to path through a temporary file and a rename.
+func rlWriteFile(fn, path string, data []byte) error {
+	f, err := os.CreateTemp(filepath.Dir(path), "."+filepath.Base(path)+".tmp-*")
+	if err != nil {
+		return fmt.Errorf("%s: %w", fn, err)
+	}
+	tmp := f.Name()
+	_, err = f.Write(data)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(tmp, path)
+	}
+	if err != nil {
+		os.Remove(tmp)
+		return fmt.Errorf("%s: %w", fn, err)
+	}
+	return nil
+}
+
+// registerRLSnapshotFunctions registers rlSave, rlLoad, rlTrackDeltas,
+// rlTakeDelta and rlMergeDelta.
+func registerRLSnapshotFunctions(rt *Runtime) {
+	// rlSave writes a covariance "diagonal" model to a snapshot file
+	//
+	// Chariot signature: rlSave(handle, path) -> Bool
+	rt.Register("rlSave", func(args ...Value) (Value, error) {
+		h, path, err := rlHandlePathArgs("rlSave", args)
+		if err != nil {
+			return nil, err
+		}
+		if err := h.WriteSnapshot(path); err != nil {
+			return nil, err
+		}
+		return Bool(true), nil
+	})
+
+	// rlLoad opens a snapshot file as a new RL handle
+	//
+	// Chariot signature: rlLoad(path, [mode]) -> RLHandle
+	//
+	// mode: "copy" (default) loads the model into memory; "shared" maps the
+	// file read-only so worker processes share one copy
+	rt.Register("rlLoad", func(args ...Value) (Value, error) {
+		if len(args) < 1 || len(args) > 2 {
+			return nil, errors.New("rlLoad requires 1-2 arguments")
+		}
+		for i, arg := range args {
+			if tvar, ok := arg.(ScopeEntry); ok {
+				args[i] = tvar.Value
+			}
+		}
+		path, ok := args[0].(Str)
+		if !ok {
+			return nil, fmt.Errorf("rlLoad: path must be a string, got %T", args[0])
+		}
+		shared := false
+		if len(args) == 2 {
+			switch mode, _ := args[1].(Str); mode {
+			case "copy":
+			case "shared":
+				shared = true
+			default:
+				return nil, fmt.Errorf("rlLoad: mode must be \"copy\" or \"shared\", got %v", args[1])
+			}
+		}
+		h, err := OpenRLSnapshot(string(path), shared)
+		if err != nil {
+			return nil, err
+		}
+		return h, nil
+	})
+
+	// rlTrackDeltas makes a handle record what it learns for rlTakeDelta
+	//
+	// Chariot signature: rlTrackDeltas(handle) -> Bool
+	rt.Register("rlTrackDeltas", func(args ...Value) (Value, error) {
+		if len(args) != 1 {
+			return nil, errors.New("rlTrackDeltas requires 1 argument")
+		}
+		arg := args[0]
+		if tvar, ok := arg.(ScopeEntry); ok {
+			arg = tvar.Value
+		}
+		h, ok := arg.(*RLHandle)
+		if !ok {
+			return nil, fmt.Errorf("rlTrackDeltas: argument must be RL handle from rlInit, got %T", arg)
+		}
+		if err := h.TrackDeltas(); err != nil {
+			return nil, err
+		}
+		return Bool(true), nil
+	})
+
+	// rlTakeDelta writes what a handle has learned since the last call to a
+	// delta file and clears it once the file is written
+	//
+	// Chariot signature: rlTakeDelta(handle, path) -> Number (features in the delta)
+	rt.Register("rlTakeDelta", func(args ...Value) (Value, error) {
+		h, path, err := rlHandlePathArgs("rlTakeDelta", args)
+		if err != nil {
+			return nil, err
+		}
+		count, err := h.WriteDelta(path)
+		if err != nil {
+			return nil, err
+		}
+		return Number(count), nil
+	})
+
+	// rlMergeDelta adds a delta file from rlTakeDelta to a handle's model
+	//
+	// Chariot signature: rlMergeDelta(handle, path) -> Bool
+	rt.Register("rlMergeDelta", func(args ...Value) (Value, error) {
+		h, path, err := rlHandlePathArgs("rlMergeDelta", args)
+		if err != nil {
+			return nil, err
+		}
+		delta, err := os.ReadFile(path)
+		if err != nil {
+			return nil, fmt.Errorf("rlMergeDelta: %w", err)
+		}
+		if err := h.MergeDelta(delta); err != nil {
+			return nil, err
+		}
+		return Bool(true), nil
+	})
+}
+
+// rlHandlePathArgs unpacks (handle, path) arguments.
+func rlHandlePathArgs(fn string, args []Value) (*RLHandle, string, error) {
+	if len(args) != 2 {
+		return nil, "", fmt.Errorf("%s requires 2 arguments", fn)
+	}
+	for i, arg := range args {
+		if tvar, ok := arg.(ScopeEntry); ok {
+			args[i] = tvar.Value
+		}
+	}
+	h, ok := args[0].(*RLHandle)
+	if !ok {
+		return nil, "", fmt.Errorf("%s: first argument must be RL handle from rlInit, got %T", fn, args[0])
+	}
+	path, ok := args[1].(Str)
+	if !ok {
+		return nil, "", fmt.Errorf("%s: path must be a string, got %T", fn, args[1])
+	}
+	return h, string(path), nil
+}
@@ -0,0 +1,266 @@
+package chariot
+
+import (
+	"errors"
+	"fmt"
+	"sort"
+	"sync"
+)
+
+// RLSparseBatch holds candidate features as index/value pairs in
+// compressed rows: candidate c has the features Index[Offsets[c]:Offsets[c+1]]
+// with values at the same positions in Values. Offsets has one entry per
+// candidate plus a final len(Index); indices within a candidate are
+// strictly increasing. Features not listed are 0.
+type RLSparseBatch struct {
+	Offsets []int32
+	Index   []int32
+	Values  []float32
+}
+
+// Candidates returns the number of candidates in b.
+func (b *RLSparseBatch) Candidates() int {
+	if len(b.Offsets) == 0 {
+		return 0
+	}
+	return len(b.Offsets) - 1
+}
+
+// checkOut validates b for featDim features per candidate and one score
+// per candidate in out.
+func (b *RLSparseBatch) checkOut(featDim int, out []float64) error {
+	const fn = "rlScoreSparse"
+	n := b.Candidates()
+	if n == 0 {
+		return fmt.Errorf("%s: no candidates", fn)
+	}
+	if len(out) != n {
+		return fmt.Errorf("%s: %d scores for %d candidates", fn, len(out), n)
+	}
+	if len(b.Index) != len(b.Values) || b.Offsets[0] != 0 || int(b.Offsets[n]) != len(b.Index) {
+		return fmt.Errorf("%s: offsets must run from 0 to %d, the number of index/value pairs", fn, len(b.Index))
+	}
+	for c := 0; c < n; c++ {
+		lo, hi := b.Offsets[c], b.Offsets[c+1]
+		if hi < lo {
+			return fmt.Errorf("%s: offsets decrease at candidate %d", fn, c)
+		}
+		prev := int32(-1)
+		for _, i := range b.Index[lo:hi] {
+			if i <= prev || int(i) >= featDim {
+				return fmt.Errorf("%s: candidate %d: indices must increase and lie in [0, %d)", fn, c, featDim)
+			}
+			prev = i
+		}
+	}
+	return nil
+}
+
+// clone returns a copy of b that shares no storage with it.
+func (b *RLSparseBatch) clone() *RLSparseBatch {
+	return &RLSparseBatch{
+		Offsets: append([]int32(nil), b.Offsets...),
+		Index:   append([]int32(nil), b.Index...),
+		Values:  append([]float32(nil), b.Values...),
+	}
+}
+
+// slice returns candidates lo..hi-1 of b as a batch sharing b's pairs,
+// with offsets rebased into the reusable buf.
+func (b *RLSparseBatch) slice(lo, hi int, buf []int32) (*RLSparseBatch, []int32) {
+	base := b.Offsets[lo]
+	buf = buf[:0]
+	for _, o := range b.Offsets[lo : hi+1] {
+		buf = append(buf, o-base)
+	}
+	end := b.Offsets[hi]
+	return &RLSparseBatch{Offsets: buf, Index: b.Index[base:end], Values: b.Values[base:end]}, buf
+}
+
+// densify writes candidates lo..hi-1 of b as dense rows into dst.
+func (b *RLSparseBatch) densify(lo, hi, featDim int, dst []float32) {
+	clear(dst)
+	for c := lo; c < hi; c++ {
+		row := dst[(c-lo)*featDim:]
+		for k := b.Offsets[c]; k < b.Offsets[c+1]; k++ {
+			row[b.Index[k]] = b.Values[k]
+		}
+	}
+}
+
+// rlDenseTilePool recycles the dense tiles sparse batches are expanded into
+// for the library, which only takes dense features.
+var rlDenseTilePool = sync.Pool{New: func() interface{} { return new([]float32) }}
+
+// ScoreSparseInto scores the candidates of b, writing one score per
+// candidate to out. A handle with covariance "diagonal" scores the pairs
+// directly, in time proportional to their number. Library handles expand
+// the pairs a tile at a time (as ScoreSelect does) into a pooled buffer and
+// score each tile in place, so memory stays bounded by the tile. Safe for
+// concurrent use.
+func (h *RLHandle) ScoreSparseInto(b *RLSparseBatch, out []float64) error {
+	_, err := h.scoreSparse(b, out)
+	return err
+}
+
+// ScoreSparseBatch is ScoreSparseInto that also keeps a copy of b and
+// returns a token for Learn, as ScoreBatch does for dense features.
+func (h *RLHandle) ScoreSparseBatch(b *RLSparseBatch, out []float64) (uint64, error) {
+	featDim, err := h.scoreSparse(b, out)
+	if err != nil {
+		return 0, err
+	}
+	return h.storeSparseBatch(b.clone(), featDim), nil
+}
+
+// scoreSparse is ScoreSparseInto, returning the model's feature dimension.
+func (h *RLHandle) scoreSparse(b *RLSparseBatch, out []float64) (int, error) {
+	if err := h.check("rlScoreSparse"); err != nil {
+		return 0, err
+	}
+	if h.diag != nil {
+		if err := b.checkOut(h.diag.dim, out); err != nil {
+			return 0, err
+		}
+		return h.diag.dim, h.diag.scoreSparse(b, out)
+	}
+
+	s := h.acquire()
+	defer s.mu.Unlock()
+	if s.handle == nil {
+		return 0, errors.New("rlScoreSparse: handle is closed")
+	}
+	featDim := rlFeatDim(s.handle)
+	if err := b.checkOut(featDim, out); err != nil {
+		return 0, err
+	}
+	n := b.Candidates()
+	tile := rlSelectTileBytes / (4 * featDim)
+	if tile < 1 {
+		tile = 1
+	}
+	if tile > n {
+		tile = n
+	}
+	buf := rlDenseTilePool.Get().(*[]float32)
+	defer rlDenseTilePool.Put(buf)
+	if cap(*buf) < tile*featDim {
+		*buf = make([]float32, tile*featDim)
+	}
+	for start := 0; start < n; start += tile {
+		end := min(start+tile, n)
+		feats := (*buf)[:(end-start)*featDim]
+		b.densify(start, end, featDim, feats)
+		if err := rlScore(s.handle, feats, featDim, out[start:end]); err != nil {
+			return 0, fmt.Errorf("rlScoreSparse: %w", err)
+		}
+	}
+	return featDim, nil
+}
+
+// registerRLSparseFunctions registers rlScoreSparse.
+func registerRLSparseFunctions(rt *Runtime) {
+	// rlScoreSparse scores candidates given as index/value feature pairs
+	//
+	// Chariot signature: rlScoreSparse(handle, candidates) -> map
+	//
+	// candidates: Array of candidates, each an Array of [index, value]
+	// pairs; features not listed are 0
+	//
+	// Returns: { "scores": [...], "token": n }, as rlScoreBatch
+	//
+	// Example:
+	//   setq(r, rlScoreSparse(rlHandle, [[[3, 1.0], [4096, 0.5]], [[17, 1.0]]]))
+	//   rlLearn(rlHandle, '{"rewards": [1.0, 0.0]}', getProp(r, "token"))
+	rt.Register("rlScoreSparse", func(args ...Value) (Value, error) {
+		if len(args) != 2 {
+			return nil, errors.New("rlScoreSparse requires 2 arguments")
+		}
+		for i, arg := range args {
+			if tvar, ok := arg.(ScopeEntry); ok {
+				args[i] = tvar.Value
+			}
+		}
+
+		rlHandle, ok := args[0].(*RLHandle)
+		if !ok {
+			return nil, fmt.Errorf("rlScoreSparse: first argument must be RL handle from rlInit, got %T", args[0])
+		}
+		batch, err := rlSparseCandidates(args[1])
+		if err != nil {
+			return nil, err
+		}
+
+		scores := make([]float64, batch.Candidates())
+		token, err := rlHandle.ScoreSparseBatch(batch, scores)
+		if err != nil {
+			return nil, err
+		}
+
+		elems := make([]Value, len(scores))
+		for i, score := range scores {
+			elems[i] = Number(score)
+		}
+		result := NewMap()
+		result.Values["scores"] = NewArrayWithValues(elems)
+		result.Values["token"] = Number(token)
+		return result, nil
+	})
+}
+
+// rlSparseCandidates converts an Array of [index, value] pair Arrays into
+// a batch, sorting each candidate's pairs by index.
+func rlSparseCandidates(arg Value) (*RLSparseBatch, error) {
+	arr, ok := arg.(*ArrayValue)
+	if !ok || len(arr.Elements) == 0 {
+		return nil, fmt.Errorf("rlScoreSparse: candidates must be a non-empty array of arrays, got %T", arg)
+	}
+	b := &RLSparseBatch{Offsets: make([]int32, 1, len(arr.Elements)+1)}
+	for c, v := range arr.Elements {
+		if tvar, ok := v.(ScopeEntry); ok {
+			v = tvar.Value
+		}
+		row, ok := v.(*ArrayValue)
+		if !ok {
+			return nil, fmt.Errorf("rlScoreSparse: candidate %d is not an array, got %T", c, v)
+		}
+		start := len(b.Index)
+		for _, p := range row.Elements {
+			if tvar, ok := p.(ScopeEntry); ok {
+				p = tvar.Value
+			}
+			pair, ok := p.(*ArrayValue)
+			if !ok || len(pair.Elements) != 2 {
+				return nil, fmt.Errorf("rlScoreSparse: candidate %d: features must be [index, value] pairs", c)
+			}
+			idx, ok1 := pair.Elements[0].(Number)
+			val, ok2 := pair.Elements[1].(Number)
+			if !ok1 || !ok2 || idx < 0 || idx != Number(int32(idx)) {
+				return nil, fmt.Errorf("rlScoreSparse: candidate %d: features must be [index, value] pairs with an integer index", c)
+			}
+			b.Index = append(b.Index, int32(idx))
+			b.Values = append(b.Values, float32(val))
+		}
+		sort.Sort(rlPairs{b.Index[start:], b.Values[start:]})
+		for k := start + 1; k < len(b.Index); k++ {
+			if b.Index[k] == b.Index[k-1] {
+				return nil, fmt.Errorf("rlScoreSparse: candidate %d: index %d given twice", c, b.Index[k])
+			}
+		}
+		b.Offsets = append(b.Offsets, int32(len(b.Index)))
+	}
+	return b, nil
+}
+
+// rlPairs sorts index/value pairs by index.
+type rlPairs struct {
+	index  []int32
+	values []float32
+}
+
+func (p rlPairs) Len() int           { return len(p.index) }
+func (p rlPairs) Less(i, j int) bool { return p.index[i] < p.index[j] }
+func (p rlPairs) Swap(i, j int) {
+	p.index[i], p.index[j] = p.index[j], p.index[i]
+	p.values[i], p.values[j] = p.values[j], p.values[i]
+}
@@ -10,8 +10,18 @@ func rlInit_impl(configJSON string) (interface{}, error) {
 }
 
 // rlScore_impl is the stub implementation when CGO is disabled
-func rlScore_impl(handle interface{}, features []float64, featDim int) ([]float64, error) {
-	return nil, fmt.Errorf("rlScore: RL support not available (CGO disabled)")
+func rlScore_impl(handle interface{}, features []float32, featDim int, out []float64) error {
+	return fmt.Errorf("rlScore: RL support not available (CGO disabled)")
+}
+
+// rlPrepare_impl is the stub implementation when CGO is disabled
+func rlPrepare_impl(handle interface{}, masks []byte, numItems int, features []float32) error {
+	return fmt.Errorf("rlPrepare: RL support not available (CGO disabled)")
+}
+
+// rlFeatDim_impl is the stub implementation when CGO is disabled
+func rlFeatDim_impl(handle interface{}) int {
+	return -1
 }
 
 // rlLearn_impl is the stub implementation when CGO is disabled
@@ -8,6 +8,7 @@ type RLConfig struct {
 	ModelPath   string  `json:"model_path,omitempty"`   // Optional: Path to ONNX model file
 	ModelInput  string  `json:"model_input,omitempty"`  // Optional: ONNX input tensor name
 	ModelOutput string  `json:"model_output,omitempty"` // Optional: ONNX output tensor name
+	Covariance  string  `json:"covariance,omitempty"`   // Optional: "library" (default) or "diagonal" (see rlDiagModel)
 }
 
 // RLFeedback contains feedback data for updating the RL model
@@ -0,0 +1,238 @@
+package tests
+
+import (
+	"encoding/json"
+	"fmt"
+	"math/rand"
+	"os"
+	"sort"
+	"strconv"
+	"testing"
+	"time"
+
+	"github.com/bhouse1273/chariot-ecosystem/services/go-chariot/chariot"
+)
+
+// Knapsack solver benchmarks on synthetic instances.
+//
+//	go test ./tests -run '^$' -bench BenchmarkKnapsack -benchtime 5x
+//
+// Sub-benchmarks are named backend/class/n=items, so results from the CPU,
+// CUDA and Metal builds can be compared with benchstat. Besides ns/op,
+// each reports allocations, solves/s and gap_% (distance of the solution
+// below the LP relaxation bound, an upper bound on the optimum). Instances
+// are seeded and identical across runs.
+//
+// Sizes default to 1k-100k items; CHARIOT_KNAPSACK_BENCH_MAX_ITEMS raises
+// the cap (up to 2M) and CHARIOT_KNAPSACK_BENCH_OPTIONS sets solver options.
+
+// knapsackBenchSizes are the instance sizes, capped by the environment.
+var knapsackBenchSizes = []int{1_000, 10_000, 100_000, 1_000_000, 2_000_000}
+
+// knapsackInstance is a generated single-capacity knapsack instance.
+type knapsackInstance struct {
+	value, weight []float64
+	limit         float64
+}
+
+// newKnapsackInstance generates n items in the classic Pisinger classes:
+// weights are uniform in [1, 1000]; values are uniform and independent
+// ("uncorrelated"), within 100 of the weight ("weak"), or the weight plus
+// 100 ("strong"). The capacity is half the total weight.
+func newKnapsackInstance(class string, n int, seed int64) knapsackInstance {
+	rng := rand.New(rand.NewSource(seed))
+	inst := knapsackInstance{value: make([]float64, n), weight: make([]float64, n)}
+	var total float64
+	for i := 0; i < n; i++ {
+		w := float64(1 + rng.Intn(1000))
+		var v float64
+		switch class {
+		case "uncorrelated":
+			v = float64(1 + rng.Intn(1000))
+		case "weak":
+			v = w + float64(rng.Intn(201)-100)
+			if v < 1 {
+				v = 1
+			}
+		default: // strong
+			v = w + 100
+		}
+		inst.weight[i], inst.value[i] = w, v
+		total += w
+	}
+	inst.limit = total / 2
+	return inst
+}
+
+// config returns the V2 config for the instance's columns.
+func (inst knapsackInstance) config() string {
+	cfg := map[string]interface{}{
+		"version":     2,
+		"mode":        "select",
+		"items":       map[string]interface{}{},
+		"blocks":      []interface{}{map[string]interface{}{"name": "all", "start": 0, "count": len(inst.value)}},
+		"objective":   []interface{}{map[string]interface{}{"attr": "value", "weight": 1.0}},
+		"constraints": []interface{}{map[string]interface{}{"kind": "capacity", "attr": "weight", "limit": inst.limit}},
+	}
+	data, _ := json.Marshal(cfg)
+	return string(data)
+}
+
+// inlineConfig returns config with the columns inline as items.attributes,
+// for the solve paths that take a whole config.
+func (inst knapsackInstance) inlineConfig() string {
+	cfg := map[string]interface{}{}
+	json.Unmarshal([]byte(inst.config()), &cfg)
+	cfg["items"] = map[string]interface{}{
+		"count":      len(inst.value),
+		"attributes": map[string]interface{}{"value": inst.value, "weight": inst.weight},
+	}
+	data, _ := json.Marshal(cfg)
+	return string(data)
+}
+
+// lpBound is the Dantzig bound: items by value density, the last one
+// taken fractionally.
+func (inst knapsackInstance) lpBound() float64 {
+	order := make([]int, len(inst.value))
+	for i := range order {
+		order[i] = i
+	}
+	sort.Slice(order, func(a, b int) bool {
+		i, j := order[a], order[b]
+		return inst.value[i]*inst.weight[j] > inst.value[j]*inst.weight[i]
+	})
+	var bound, used float64
+	for _, i := range order {
+		if used+inst.weight[i] > inst.limit {
+			return bound + inst.value[i]*(inst.limit-used)/inst.weight[i]
+		}
+		used += inst.weight[i]
+		bound += inst.value[i]
+	}
+	return bound
+}
+
+func knapsackBenchMaxItems(b *testing.B) int {
+	limit := 100_000
+	if s := os.Getenv("CHARIOT_KNAPSACK_BENCH_MAX_ITEMS"); s != "" {
+		n, err := strconv.Atoi(s)
+		if err != nil {
+			b.Fatalf("CHARIOT_KNAPSACK_BENCH_MAX_ITEMS: %v", err)
+		}
+		limit = n
+	}
+	return limit
+}
+
+func BenchmarkKnapsack(b *testing.B) {
+	maxItems := knapsackBenchMaxItems(b)
+	options := os.Getenv("CHARIOT_KNAPSACK_BENCH_OPTIONS")
+	for _, class := range []string{"uncorrelated", "weak", "strong"} {
+		for _, n := range knapsackBenchSizes {
+			if n > maxItems {
+				continue
+			}
+			inst := newKnapsackInstance(class, n, int64(n))
+			name := fmt.Sprintf("%s/%s/n=%d", chariot.KnapsackBackend(), class, n)
+			b.Run(name, func(b *testing.B) {
+				p, err := chariot.PrepareKnapsackColumns(inst.config(), map[string][]float64{"value": inst.value, "weight": inst.weight})
+				if err != nil {
+					b.Fatal(err)
+				}
+				defer p.Release()
+				bound := inst.lpBound()
+
+				// Solve into one reused solution, as a steady-state caller would.
+				var sol chariot.V2Solution
+				b.ReportAllocs()
+				b.ResetTimer()
+				start := time.Now()
+				for i := 0; i < b.N; i++ {
+					if err := p.SolvePreparedInto("", options, &sol); err != nil {
+						b.Fatal(err)
+					}
+				}
+				elapsed := time.Since(start)
+				b.StopTimer()
+
+				b.ReportMetric(float64(b.N)/elapsed.Seconds(), "solves/s")
+				b.ReportMetric(100*(bound-sol.Total)/bound, "gap_%")
+			})
+		}
+	}
+}
+
+// BenchmarkKnapsackBatch measures throughput for many small instances.
+func BenchmarkKnapsackBatch(b *testing.B) {
+	configs := make([]string, 64)
+	for i := range configs {
+		configs[i] = newKnapsackInstance("weak", 200, int64(i)).inlineConfig()
+	}
+	b.Run(fmt.Sprintf("%s/weak/n=200x%d", chariot.KnapsackBackend(), len(configs)), func(b *testing.B) {
+		start := time.Now()
+		for i := 0; i < b.N; i++ {
+			_, errs, err := chariot.SolveKnapsackBatch(configs, "")
+			if err != nil {
+				b.Fatal(err)
+			}
+			for _, err := range errs {
+				if err != nil {
+					b.Fatal(err)
+				}
+			}
+		}
+		b.ReportMetric(float64(b.N*len(configs))/time.Since(start).Seconds(), "solves/s")
+	})
+}
+
+// BenchmarkKnapsackRLObjective measures solves whose objective is scored
+// by a bound RL handle (see BindRLScores): "cached" reuses the scores,
+// "learned" rescores every item after one rlLearn per solve.
+func BenchmarkKnapsackRLObjective(b *testing.B) {
+	const n, featDim = 10_000, 16
+	inst := newKnapsackInstance("uncorrelated", n, n)
+	h, err := chariot.NewRLHandle(fmt.Sprintf(`{"feat_dim": %d, "alpha": 0.3}`, featDim), 1)
+	if err != nil {
+		b.Skipf("RL library unavailable: %v", err)
+	}
+	defer h.Close()
+	features := make([]float32, n*featDim)
+	for i := range features {
+		features[i] = float32(i%17) / 17
+	}
+	for _, learn := range []bool{false, true} {
+		name := "cached"
+		if learn {
+			name = "learned"
+		}
+		b.Run(fmt.Sprintf("%s/%s/n=%d", chariot.KnapsackBackend(), name, n), func(b *testing.B) {
+			p, err := chariot.PrepareKnapsackColumns(inst.config(), map[string][]float64{"value": inst.value, "weight": inst.weight})
+			if err != nil {
+				b.Fatal(err)
+			}
+			defer p.Release()
+			if err := p.BindRLScores("value", h, features, featDim); err != nil {
+				b.Fatal(err)
+			}
+			var sol chariot.V2Solution
+			scores := make([]float64, 1)
+			b.ReportAllocs()
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if learn {
+					token, err := h.ScoreBatch(features[:featDim], featDim, scores)
+					if err == nil {
+						err = h.Learn(`{"rewards": [0.5]}`, token)
+					}
+					if err != nil {
+						b.Fatal(err)
+					}
+				}
+				if err := p.SolvePreparedInto("", "", &sol); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
@@ -1,7 +1,11 @@
 package tests
 
 import (
+	"context"
+	"os"
+	"strings"
 	"testing"
+	"time"
 
 	"github.com/bhouse1273/chariot-ecosystem/services/go-chariot/chariot"
 )
@@ -110,6 +114,101 @@ func TestKnapsackSolver(t *testing.T) {
 			},
 			ExpectedValue: chariot.Bool(true),
 		},
+		{
+			Name: "Backend option matching the linked library",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`setq(result, knapsack(cfg, concat('{"backend": "', knapsackBackend(), '"}')))`,
+				`equal(getProp(result, "backend"), knapsackBackend())`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name:          "Linked library reports where it solves",
+			Script:        []string{`contains(["cpu", "metal"], knapsackBackend())`},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "CUDA backend option is rejected without a device solve path",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`knapsack(cfg, '{"backend": "cuda"}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: `backend "cuda" is not available in this build`,
+		},
+		{
+			Name: "Stats option reports solve phases",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`setq(result, knapsack(cfg, '{"stats": true, "threads": 2}'))`,
+				`getProp(getProp(result, "stats"), "solves")`,
+			},
+			ExpectedValue: chariot.Number(1),
+		},
+		{
+			Name: "Stats option must be boolean",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`knapsack(cfg, '{"stats": "yes"}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "stats must be a boolean",
+		},
+		{
+			Name: "Exact engine proves optimality",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 5.0, [2.0, 3.0, 4.0], [10.0, 15.0, 18.0]))`,
+				`setq(result, knapsack(cfg, '{"engine": "exact"}'))`,
+				`and(equal(getProp(result, "total"), 25), getProp(getProp(result, "bound"), "optimal"))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Unknown engine option",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`knapsack(cfg, '{"engine": "fast"}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "engine must be",
+		},
+		{
+			Name: "Unknown backend option",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`knapsack(cfg, '{"backend": "tpu"}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "unknown backend",
+		},
+		{
+			Name: "Seed option must be integer",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`knapsack(cfg, '{"seed": "abc"}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "seed must be an integer",
+		},
+		{
+			Name: "Reduce option on knapsack",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 5.0, [2.0, 3.0, 9.0], [10.0, 15.0, 18.0]))`,
+				`setq(result, knapsack(cfg, '{"reduce": true}'))`,
+				`getProp(getProp(result, "reduction"), "kept")`,
+			},
+			ExpectedValue: chariot.Number(2),
+		},
+		{
+			Name: "Check solution reports backend",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1], 5.0, [2.0], [10.0]))`,
+				`setq(result, knapsack(cfg))`,
+				`equal(typeOf(getProp(result, "backend")), "S")`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
 		{
 			Name: "Knapsack with options JSON",
 			Script: []string{
@@ -120,6 +219,86 @@ func TestKnapsackSolver(t *testing.T) {
 			},
 			ExpectedValue: chariot.Number(3),
 		},
+		{
+			Name: "Knapsack with threads option",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(result, knapsack(cfg, '{"threads": 4, "seed": 7}'))`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(13),
+		},
+		{
+			Name: "Threads portfolio improves on a single solve",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3, 4, 5, 6], 16.0, [6.0, 1.0, 9.0, 7.0, 2.0, 8.0], [7.0, 5.0, 8.0, 6.0, 5.0, 8.0]))`,
+				`setq(one, knapsack(cfg))`,
+				`setq(four, knapsack(cfg, '{"threads": 4}'))`,
+				`and(equal(getProp(one, "total"), 20), equal(getProp(four, "total"), 23))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Knapsack with invalid threads option",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`knapsack(cfg, '{"threads": 0}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "threads must be an integer",
+		},
+		{
+			Name: "Knapsack with time budget",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(result, knapsack(cfg, '{"time_budget_ms": 100, "beam_width": 16}'))`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(13),
+		},
+		{
+			Name: "Time budget refines the library solution",
+			Script: []string{
+				// The library's solve falls short; items 1, 2, 4 and 5 fill the capacity for 23
+				`setq(cfg, knapsackConfig([1, 2, 3, 4, 5, 6], 16.0, [6.0, 1.0, 9.0, 7.0, 2.0, 8.0], [7.0, 5.0, 8.0, 6.0, 5.0, 8.0]))`,
+				`getProp(knapsack(cfg, '{"time_budget_ms": 20}'), "total")`,
+			},
+			ExpectedValue: chariot.Number(23),
+		},
+		{
+			Name: "Knapsack with invalid time budget",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`knapsack(cfg, '{"time_budget_ms": 0}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "time_budget_ms must be a positive number",
+		},
+		{
+			Name: "Knapsack batch solves each config",
+			Script: []string{
+				`setq(a, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(b, knapsackConfig([1, 2, 3], 9.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(results, knapsackBatch([a, b, a], '{"threads": 2}'))`,
+				`add(getProp(getAt(results, 1), "objective"), getProp(getAt(results, 2), "objective"))`,
+			},
+			ExpectedValue: chariot.Number(31),
+		},
+		{
+			Name: "Knapsack batch reports a failed instance in place",
+			Script: []string{
+				`setq(a, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(results, knapsackBatch([a, "not json", a]))`,
+				`and(equal(getProp(getAt(results, 2), "objective"), 13), contains(getProp(getAt(results, 1), "error"), "SolveKnapsack"))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name:           "Knapsack batch with non-string config",
+			Script:         []string{`knapsackBatch(["{}", 5])`},
+			ExpectedError:  true,
+			ErrorSubstring: "knapsackBatch configs[1] must be string",
+		},
 		{
 			Name:           "Knapsack with missing config argument",
 			Script:         []string{`knapsack()`},
@@ -143,6 +322,461 @@ func TestKnapsackSolver(t *testing.T) {
 	RunTestCases(t, tests)
 }
 
+// TestKnapsackPrepared tests the prepared-problem handle (parse once, solve many)
+func TestKnapsackPrepared(t *testing.T) {
+	// Failing cases stop before their own deleteFile.
+	t.Cleanup(func() {
+		for _, name := range []string{"knapsack_not_columns.kscol", "knapsack_bad_items.csv", "knapsack_inf_items.csv", "knapsack_mixed_items.csv"} {
+			if path, err := chariot.GetSecureFilePath(name, "data"); err == nil {
+				os.Remove(path)
+			}
+		}
+	})
+	tests := []TestCase{
+		{
+			Name: "Prepared solve matches knapsack()",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(h, knapsackPrepare(cfg))`,
+				`setq(result, knapsackSolvePrepared(h))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(13),
+		},
+		{
+			Name: "Override capacity limit per solve",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(h, knapsackPrepare(cfg))`,
+				`setq(small, knapsackSolvePrepared(h, '{"limits": {"weight": 4.0}}'))`,
+				`setq(large, knapsackSolvePrepared(h, '{"limits": {"weight": 9.0}}'))`,
+				`knapsackRelease(h)`,
+				`add(getProp(small, "objective"), getProp(large, "objective"))`,
+			},
+			ExpectedValue: chariot.Number(25), // 7 + 18
+		},
+		{
+			Name: "Override objective weight per solve",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0]))`,
+				`setq(h, knapsackPrepare(cfg))`,
+				`setq(result, knapsackSolvePrepared(h, '{"weights": {"value": 2.0}}'))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(26),
+		},
+		{
+			Name: "Override unknown attr",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0])))`,
+				`knapsackSolvePrepared(h, '{"limits": {"volume": 4.0}}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "no term with attr",
+		},
+		{
+			Name: "Solve after release",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0])))`,
+				`knapsackRelease(h)`,
+				`knapsackSolvePrepared(h)`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "released",
+		},
+		{
+			Name: "Update item value in place",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`knapsackUpdate(h, '{"update": [{"index": 0, "attr": "value", "value": 100.0}]}')`,
+				`setq(result, knapsackSolvePrepared(h))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(107),
+		},
+		{
+			Name: "Insert and delete items",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`setq(n, knapsackUpdate(h, '{"delete": [2], "insert": [{"value": 50.0, "weight": 1.0}, {"value": 1.0, "weight": 100.0}]}'))`,
+				`setq(result, knapsackSolvePrepared(h))`,
+				`knapsackRelease(h)`,
+				`add(n, getProp(result, "objective"))`,
+			},
+			ExpectedValue: chariot.Number(65), // 4 items + 5 + 6 + 50
+		},
+		{
+			Name: "Insert and delete items in indexed blocks",
+			Script: []string{
+				`setq(h, knapsackPrepare('{"version": 2, "mode": "select", "items": {"count": 4, "attributes": {"value": [5.0, 6.0, 7.0, 8.0], "weight": [2.0, 3.0, 4.0, 5.0]}}, "blocks": [{"name": "a", "indices": [0, 2]}, {"name": "b", "indices": [1, 3]}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "capacity", "attr": "weight", "limit": 7.0}]}'))`,
+				`setq(n, knapsackUpdate(h, '{"delete": [0], "insert": [{"value": 50.0, "weight": 1.0}]}'))`,
+				`setq(result, knapsackSolvePrepared(h))`,
+				`knapsackRelease(h)`,
+				`add(n, getProp(result, "objective"))`,
+			},
+			ExpectedValue: chariot.Number(62), // 4 items + 8 + 50
+		},
+		{
+			Name: "Reduced solve drops oversize and valueless items",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3, 4, 5], 7.0, [2.0, 3.0, 4.0, 20.0, 1.0], [5.0, 6.0, 7.0, 9.0, 0.0])))`,
+				`setq(result, knapsackSolvePrepared(h, "", '{"reduce": true}'))`,
+				`knapsackRelease(h)`,
+				`add(getProp(getProp(result, "reduction"), "kept"), getProp(result, "objective"))`,
+			},
+			ExpectedValue: chariot.Number(16), // 3 items kept + 6 + 7
+		},
+		{
+			Name: "Reduction is reused by later solves",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3, 4], 7.0, [2.0, 3.0, 4.0, 20.0], [5.0, 6.0, 7.0, 9.0])))`,
+				`knapsackSolvePrepared(h, "", '{"reduce": true}')`,
+				`setq(result, knapsackSolvePrepared(h, "", '{"reduce": true}'))`,
+				`knapsackRelease(h)`,
+				`getProp(getProp(result, "reduction"), "cached")`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Auto engine solves a small problem exactly",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 5.0, [2.0, 3.0, 4.0], [10.0, 15.0, 18.0])))`,
+				`setq(result, knapsackSolvePrepared(h, "", '{"engine": "auto"}'))`,
+				`knapsackRelease(h)`,
+				`and(equal(getProp(result, "total"), 25), equal(getProp(result, "backend"), "go"), getProp(getProp(result, "bound"), "optimal"))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Auto engine returns a density fill that meets the bound",
+			Script: []string{
+				// 3 items x capacity 1e9 is too large for the exact engine
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 1000000000.0, [500000000.0, 500000000.0, 300000000.0], [5.0, 5.0, 3.0])))`,
+				`setq(result, knapsackSolvePrepared(h, "", '{"engine": "auto"}'))`,
+				`knapsackRelease(h)`,
+				`and(equal(getProp(result, "total"), 10), equal(getProp(result, "backend"), "go"), getProp(getProp(result, "bound"), "optimal"))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Exact engine refuses a huge capacity",
+			Script: []string{
+				// one item x capacity 1e9 passes the cell bound, but the table
+				// of best values would need 8 GB
+				`setq(h, knapsackPrepare(knapsackConfig([1], 1000000000.0, [1000000000.0], [5.0])))`,
+				`knapsackSolvePrepared(h, "", '{"engine": "exact"}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "too large a capacity",
+		},
+		{
+			Name: "Time-budgeted solve stops at the bound",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 1000000000.0, [500000000.0, 500000000.0, 300000000.0], [5.0, 5.0, 3.0])))`,
+				`setq(result, knapsackSolvePrepared(h, "", '{"time_budget_ms": 5000, "stats": true}'))`,
+				`knapsackRelease(h)`,
+				`and(getProp(getProp(result, "bound"), "optimal"), equal(getProp(getProp(result, "stats"), "solves"), 1))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Refined solve keeps the optimum",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`setq(result, knapsackSolvePrepared(h, "", '{"lns_ms": 5, "beam_width": 1}'))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(13),
+		},
+		{
+			Name: "Refinement improves on the beam solution",
+			Script: []string{
+				// The beam solve selects items 1, 2 and 6 for 20; items 1, 2, 4 and 5 fill the capacity for 23
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3, 4, 5, 6], 16.0, [6.0, 1.0, 9.0, 7.0, 2.0, 8.0], [7.0, 5.0, 8.0, 6.0, 5.0, 8.0])))`,
+				`setq(beam, knapsackSolvePrepared(h))`,
+				`setq(refined, knapsackSolvePrepared(h, "", '{"lns_ms": 20}'))`,
+				`knapsackRelease(h)`,
+				`and(equal(getProp(beam, "total"), 20), equal(getProp(refined, "total"), 23))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Refinement budget must be non-negative",
+			Script: []string{
+				`setq(cfg, knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0]))`,
+				`knapsack(cfg, '{"lns_ms": -1}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "lns_ms must be a non-negative number",
+		},
+		{
+			Name: "RL-scored objective follows learning",
+			Script: []string{
+				// Unseen features score 0.3; a reward of 0.5 on item 0 raises it
+				// to about 0.46, and a reward of 1 on item 2 to about 0.71.
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 1.0, [1.0, 1.0, 1.0], [5.0, 6.0, 7.0])))`,
+				`setq(rl, rlInit(parseJSON('{"feat_dim": 3, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`knapsackBindRL(h, "value", rl, [1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0])`,
+				`setq(r, rlScoreBatch(rl, [1.0, 0.0, 0.0], 3))`,
+				`rlLearn(rl, parseJSON('{"rewards": [0.5]}'), getProp(r, "token"))`,
+				`setq(first, getProp(knapsackSolvePrepared(h, "", '{"engine": "exact"}'), "select"))`,
+				`setq(r, rlScoreBatch(rl, [0.0, 0.0, 1.0], 3))`,
+				`rlLearn(rl, parseJSON('{"rewards": [1.0]}'), getProp(r, "token"))`,
+				`setq(second, getProp(knapsackSolvePrepared(h, "", '{"engine": "exact"}'), "select"))`,
+				`knapsackRelease(h)`,
+				`rlClose(rl)`,
+				`and(equal(getAt(first, 0), 1), equal(getAt(first, 2), 0), equal(getAt(second, 0), 0), equal(getAt(second, 2), 1))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "RL scores of changed features are refreshed on invalidation",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 1.0, [1.0, 1.0, 1.0], [5.0, 6.0, 7.0])))`,
+				`setq(rl, rlInit(parseJSON('{"feat_dim": 3, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`setq(features, float32Buffer([1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0]))`,
+				`knapsackBindRL(h, "value", rl, features)`,
+				`setq(r, rlScoreBatch(rl, [1.0, 0.0, 0.0], 3))`,
+				`rlLearn(rl, parseJSON('{"rewards": [1.0]}'), getProp(r, "token"))`,
+				`setq(learned, getProp(knapsackSolvePrepared(h, "", '{"engine": "exact"}'), "select"))`,
+				// Item 0 loses its only feature, but keeps its cached score
+				// until it is invalidated.
+				`bufferSet(features, 0, 0.0)`,
+				`setq(cached, getProp(knapsackSolvePrepared(h, "", '{"engine": "exact"}'), "select"))`,
+				`knapsackInvalidateRL(h, [0])`,
+				`setq(rescored, getProp(knapsackSolvePrepared(h, "", '{"engine": "exact"}'), "select"))`,
+				`knapsackRelease(h)`,
+				`rlClose(rl)`,
+				`and(equal(getAt(learned, 0), 1), equal(getAt(cached, 0), 1), equal(getAt(rescored, 0), 0))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "RL invalidation needs bound scores",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0])))`,
+				`knapsackInvalidateRL(h)`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "no RL scores bound",
+		},
+		{
+			Name: "RL invalidation rejects items out of range",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0])))`,
+				`setq(rl, rlInit(parseJSON('{"feat_dim": 1, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`knapsackBindRL(h, "value", rl, [1.0, 2.0])`,
+				`knapsackInvalidateRL(h, [2])`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "out of range",
+		},
+		{
+			Name: "RL-scored attribute needs an objective term",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2], 5.0, [2.0, 3.0], [10.0, 15.0])))`,
+				`setq(rl, rlInit(parseJSON('{"feat_dim": 1, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`knapsackBindRL(h, "weight", rl, [1.0, 2.0])`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "no objective term",
+		},
+		{
+			Name: "Update unknown attribute",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`knapsackUpdate(h, '{"update": [{"index": 0, "attr": "volume", "value": 1.0}]}')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "unknown attribute",
+		},
+		{
+			Name:           "Prepare with empty items",
+			Script:         []string{`knapsackPrepare(knapsackConfig([], 10.0, [], []))`},
+			ExpectedError:  true,
+			ErrorSubstring: "items.count must be > 0",
+		},
+		{
+			Name: "Prepare with binary attribute columns",
+			Script: []string{
+				`setq(cfg, '{"version": 2, "mode": "select", "items": {}, "blocks": [{"name": "all", "start": 0, "count": 3}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "capacity", "attr": "weight", "limit": 7.0}]}')`,
+				`setq(cols, map("value", [5.0, 6.0, 7.0], "weight", [2.0, 3.0, 4.0]))`,
+				`setq(h, knapsackPrepare(cfg, cols))`,
+				`setq(result, knapsackSolvePrepared(h))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(13),
+		},
+		{
+			Name: "Prepare with mismatched column lengths",
+			Script: []string{
+				`setq(cfg, '{"version": 2, "mode": "select", "items": {}, "blocks": [{"name": "all", "start": 0, "count": 3}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "capacity", "attr": "weight", "limit": 7.0}]}')`,
+				`knapsackPrepare(cfg, map("value", [5.0, 6.0, 7.0], "weight", [2.0, 3.0]))`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "expected 3",
+		},
+		{
+			Name: "Prepare from mapped column file",
+			Script: []string{
+				`knapsackWriteColumns('knapsack_catalog.kscol', map("value", [5.0, 6.0, 7.0], "weight", [2.0, 3.0, 4.0]))`,
+				`setq(cfg, '{"version": 2, "mode": "select", "items": {}, "blocks": [{"name": "all", "start": 0, "count": 3}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "capacity", "attr": "weight", "limit": 7.0}]}')`,
+				`setq(h, knapsackPrepare(cfg, 'knapsack_catalog.kscol'))`,
+				`setq(result, knapsackSolvePrepared(h, '{"limits": {"weight": 9.0}}'))`,
+				`knapsackRelease(h)`,
+				`deleteFile('knapsack_catalog.kscol')`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(18),
+		},
+		{
+			Name: "Prepare from CSV item file",
+			Script: []string{
+				`writeFile('knapsack_items.csv', 'name,value,weight\nsofa,5.0,2.0\n"lamp, tall",6.0,3.0\ndesk,7.0,4.0')`,
+				`setq(cfg, '{"version": 2, "mode": "select", "items": {}, "blocks": [{"name": "all", "start": 0, "count": 3}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "capacity", "attr": "weight", "limit": 7.0}]}')`,
+				`setq(h, knapsackPrepare(cfg, 'knapsack_items.csv'))`,
+				`setq(result, knapsackSolvePrepared(h, '{"limits": {"weight": 9.0}}'))`,
+				`knapsackRelease(h)`,
+				`deleteFile('knapsack_items.csv')`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(18),
+		},
+		{
+			Name: "Prepare from CSV item file with a bad number",
+			Script: []string{
+				`writeFile('knapsack_bad_items.csv', 'name,value\nsofa,5.0\nlamp,six')`,
+				`knapsackPrepare('{"version": 2, "mode": "select", "items": {}, "objective": [{"attr": "value", "weight": 1.0}]}', 'knapsack_bad_items.csv')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: `row 2 column "value": invalid number`,
+		},
+		{
+			Name: "Prepare from CSV item file with an infinite number",
+			Script: []string{
+				`writeFile('knapsack_inf_items.csv', 'value,weight\n5.0,2.0\n6.0,Inf')`,
+				`knapsackPrepare('{"version": 2, "mode": "select", "items": {}}', 'knapsack_inf_items.csv')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "not finite",
+		},
+		{
+			Name: "Prepare from CSV item file decides column types from every row",
+			Script: []string{
+				"writeFile('knapsack_mixed_items.csv', '\ufeffvalue,weight,code\\n5.0,2.0,1\\n6.0,3.0,A2\\n7.0,4.0,3')", // starts with a byte order mark
+				`setq(cfg, '{"version": 2, "mode": "select", "items": {}, "blocks": [{"name": "all", "start": 0, "count": 3}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "capacity", "attr": "weight", "limit": 7.0}]}')`,
+				`setq(h, knapsackPrepare(cfg, 'knapsack_mixed_items.csv'))`,
+				`setq(result, knapsackSolvePrepared(h))`,
+				`knapsackRelease(h)`,
+				`deleteFile('knapsack_mixed_items.csv')`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(13),
+		},
+		{
+			Name: "Prepare from non-column file",
+			Script: []string{
+				`writeFile('knapsack_not_columns.kscol', 'not a column file')`,
+				`knapsackPrepare('{"version": 2, "mode": "select", "items": {}}', 'knapsack_not_columns.kscol')`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "not a knapsack column file",
+		},
+		{
+			Name:           "Solve with wrong handle type",
+			Script:         []string{`knapsackSolvePrepared("{}")`},
+			ExpectedError:  true,
+			ErrorSubstring: "must be handle from knapsackPrepare",
+		},
+	}
+
+	RunTestCases(t, tests)
+}
+
+// TestKnapsackEvaluate tests scoring and warm re-solving against a prepared problem
+func TestKnapsackEvaluate(t *testing.T) {
+	tests := []TestCase{
+		{
+			Name: "Evaluate matches solver objective",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`setq(sol, knapsackSolvePrepared(h))`,
+				`setq(evals, knapsackEvaluate(h, [getProp(sol, "select")]))`,
+				`knapsackRelease(h)`,
+				`equal(getProp(getAt(evals, 0), "objective"), getProp(sol, "objective"))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Evaluate flags capacity violation",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`setq(evals, knapsackEvaluate(h, [[1, 0, 1], [1, 1, 1]]))`,
+				`knapsackRelease(h)`,
+				`and(getProp(getAt(evals, 0), "feasible"), not(getProp(getAt(evals, 1), "feasible")))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "Resolve from prior solution after limit change",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`setq(sol, knapsackSolvePrepared(h))`,
+				`setq(result, knapsackResolve(h, sol, '{"limits": {"weight": 9.0}}'))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(18),
+		},
+		{
+			Name: "Resolve repairs infeasible prior",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`setq(result, knapsackResolve(h, [1, 1, 1]))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "objective")`,
+			},
+			ExpectedValue: chariot.Number(13),
+		},
+		{
+			Name: "Resolve reports Go-side backend",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`setq(result, knapsackResolve(h, [0, 0, 0]))`,
+				`knapsackRelease(h)`,
+				`getProp(result, "backend")`,
+			},
+			ExpectedValue: chariot.Str("go"),
+		},
+		{
+			Name: "Resolve refuses constraint kinds it does not model",
+			Script: []string{
+				`setq(cfg, '{"version": 2, "mode": "select", "items": {"count": 3, "attributes": {"value": [5.0, 6.0, 7.0], "weight": [2.0, 3.0, 4.0]}}, "blocks": [{"name": "all", "start": 0, "count": 3}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "cardinality", "attr": "weight", "limit": 1.0}]}')`,
+				`setq(h, knapsackPrepare(cfg))`,
+				`knapsackResolve(h, [0, 0, 0])`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: `constraint kind "cardinality" is not supported`,
+		},
+		{
+			Name: "Evaluate with wrong selection length",
+			Script: []string{
+				`setq(h, knapsackPrepare(knapsackConfig([1, 2, 3], 7.0, [2.0, 3.0, 4.0], [5.0, 6.0, 7.0])))`,
+				`knapsackEvaluate(h, [[1, 0]])`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "has 2 entries, expected 3",
+		},
+	}
+
+	RunTestCases(t, tests)
+}
+
 // TestKnapsackIntegration tests complete knapsack workflows
 func TestKnapsackIntegration(t *testing.T) {
 	tests := []TestCase{
@@ -218,6 +852,144 @@ func TestKnapsackIntegration(t *testing.T) {
 	RunTestCases(t, tests)
 }
 
+// TestKnapsackAnytimeBudget checks that a time-budgeted solve runs the
+// smallest library solve and ends near the deadline whatever beam_width
+// asks for.
+func TestKnapsackAnytimeBudget(t *testing.T) {
+	cfg := newKnapsackInstance("weak", 20_000, 1).inlineConfig()
+	budget := 200 * time.Millisecond
+	incumbents := make(chan chariot.KnapsackIncumbent, 64)
+	start := time.Now()
+	sol, err := chariot.SolveKnapsackAnytime(context.Background(), cfg, `{"time_budget_ms": 200, "beam_width": 4096}`, incumbents)
+	elapsed := time.Since(start)
+	if err != nil {
+		t.Fatalf("SolveKnapsackAnytime: %v", err)
+	}
+	first := <-incumbents
+	if first.BeamWidth != 1 || first.Iters != 1 {
+		t.Fatalf("first step ran beam width %d, iters %d; want 1, 1", first.BeamWidth, first.Iters)
+	}
+	if sol == nil || sol.NumItems != 20_000 {
+		t.Fatalf("unexpected solution %+v", sol)
+	}
+	// A 4096-wide solve of 20k items takes minutes; refinement stops at
+	// the deadline.
+	if elapsed > 3*budget {
+		t.Fatalf("budgeted solve took %v for a %v budget", elapsed, budget)
+	}
+}
+
+// TestKnapsackAnytimeRefines checks that the budget left after the library
+// solve goes to refinement, and that each improvement is reported.
+func TestKnapsackAnytimeRefines(t *testing.T) {
+	// The library's solve falls short of the optimum, items 1, 2, 4 and 5
+	// for 23.
+	inst := knapsackInstance{value: []float64{7, 5, 8, 6, 5, 8}, weight: []float64{6, 1, 9, 7, 2, 8}, limit: 16}
+	incumbents := make(chan chariot.KnapsackIncumbent, 64)
+	sol, err := chariot.SolveKnapsackAnytime(context.Background(), inst.inlineConfig(), `{"time_budget_ms": 20}`, incumbents)
+	if err != nil {
+		t.Fatalf("SolveKnapsackAnytime: %v", err)
+	}
+	var totals []float64
+	for inc := range incumbents {
+		if inc.Refined != (len(totals) > 0) {
+			t.Fatalf("incumbent %d has Refined %v", len(totals), inc.Refined)
+		}
+		totals = append(totals, inc.Solution.Total)
+	}
+	if len(totals) < 2 || totals[0] >= 23 || totals[len(totals)-1] != 23 || sol.Total != 23 {
+		t.Fatalf("incumbent totals %v, solution %v; want an improvement to 23", totals, sol.Total)
+	}
+}
+
+// TestKnapsackAnytimeUnreadIncumbents checks that a reader that never
+// receives does not hold the solve past its budget.
+func TestKnapsackAnytimeUnreadIncumbents(t *testing.T) {
+	cfg := newKnapsackInstance("weak", 20_000, 1).inlineConfig()
+	budget := 100 * time.Millisecond
+	start := time.Now()
+	if _, err := chariot.SolveKnapsackAnytime(context.Background(), cfg, `{"time_budget_ms": 100}`, make(chan chariot.KnapsackIncumbent)); err != nil {
+		t.Fatalf("SolveKnapsackAnytime: %v", err)
+	}
+	if elapsed := time.Since(start); elapsed > 3*budget {
+		t.Fatalf("solve with an unread channel took %v for a %v budget", elapsed, budget)
+	}
+}
+
+// TestKnapsackDomEnablePassthrough checks that dom_enable reaches the
+// library as written: the library acts on `true` but not on `1`, so `1`
+// must solve like no dom_enable at all.
+func TestKnapsackDomEnablePassthrough(t *testing.T) {
+	cfg := newKnapsackInstance("weak", 300, 1).inlineConfig()
+	base, err := chariot.SolveKnapsack(cfg, "")
+	if err != nil {
+		t.Fatalf("SolveKnapsack: %v", err)
+	}
+	sol, err := chariot.SolveKnapsack(cfg, `{"dom_enable": 1}`)
+	if err != nil {
+		t.Fatalf("SolveKnapsack: %v", err)
+	}
+	if sol.Total != base.Total {
+		t.Fatalf("dom_enable 1 gave total %v, baseline %v", sol.Total, base.Total)
+	}
+}
+
+// TestKnapsackLNSBudget checks that lns_ms bounds the warm start of the
+// refinement too: on a large problem the greedy fill and swaps alone take
+// longer than the budget.
+func TestKnapsackLNSBudget(t *testing.T) {
+	p, err := chariot.PrepareKnapsack(newKnapsackInstance("weak", 300_000, 1).inlineConfig())
+	if err != nil {
+		t.Fatalf("PrepareKnapsack: %v", err)
+	}
+	defer p.Release()
+	base, err := p.SolvePrepared("", `{"beam_width": 1}`)
+	if err != nil {
+		t.Fatalf("SolvePrepared: %v", err)
+	}
+	start := time.Now()
+	if _, err := p.SolveWarm(base.Mask, ""); err != nil {
+		t.Fatalf("SolveWarm: %v", err)
+	}
+	warm := time.Since(start)
+
+	sol, err := p.SolvePrepared("", `{"beam_width": 1, "lns_ms": 5, "stats": true}`)
+	if err != nil {
+		t.Fatalf("SolvePrepared: %v", err)
+	}
+	if sol.Total < base.Total {
+		t.Fatalf("refined total %v below the beam total %v", sol.Total, base.Total)
+	}
+	if sol.Stats.Refine >= warm {
+		t.Fatalf("5ms refinement took %v, no less than an unbounded warm search (%v)", sol.Stats.Refine, warm)
+	}
+}
+
+// TestKnapsackDeltaAtomic checks that a delta whose inserts have no block to
+// go into leaves its updates unwritten.
+func TestKnapsackDeltaAtomic(t *testing.T) {
+	cfg := `{"version": 2, "mode": "select", "items": {}, "blocks": [{"name": "head", "start": 0, "count": 2}], "objective": [{"attr": "value", "weight": 1.0}], "constraints": [{"kind": "capacity", "attr": "weight", "limit": 7.0}]}`
+	p, err := chariot.PrepareKnapsackColumns(cfg, map[string][]float64{"value": {5, 6, 7}, "weight": {2, 3, 4}})
+	if err != nil {
+		t.Fatalf("PrepareKnapsackColumns: %v", err)
+	}
+	defer p.Release()
+	err = p.ApplyDelta(&chariot.KnapsackItemDelta{
+		Update: []chariot.KnapsackItemUpdate{{Index: 0, Attr: "value", Value: 100}},
+		Insert: []map[string]float64{{"value": 1, "weight": 1}},
+	})
+	if err == nil || !strings.Contains(err.Error(), "no block ends") {
+		t.Fatalf("ApplyDelta: got %v, want a missing block error", err)
+	}
+	evals, err := p.EvaluateSelect([]chariot.SelectMask{chariot.PackSelect([]int{1, 0, 0})})
+	if err != nil {
+		t.Fatalf("EvaluateSelect: %v", err)
+	}
+	if evals[0].Objective != 5 {
+		t.Fatalf("item 0 value %v after a failed delta, want 5", evals[0].Objective)
+	}
+}
+
 // TestKnapsackPerformance tests solver with larger problems
 func TestKnapsackPerformance(t *testing.T) {
 	tests := []TestCase{
@@ -0,0 +1,109 @@
+package tests
+
+import (
+	"fmt"
+	"testing"
+
+	"github.com/bhouse1273/chariot-ecosystem/services/go-chariot/chariot"
+)
+
+// RL scoring benchmarks (rl_score_batch_with_features through
+// RLHandle.ScoreInto, which passes buffers in place).
+//
+//	go test ./tests -run '^$' -bench BenchmarkRLScore
+//
+// Sub-benchmarks are named backend/feat_dim=d/batch=n and report
+// ns/candidate alongside ns/op.
+func BenchmarkRLScore(b *testing.B) {
+	for _, dim := range []int{8, 16, 64, 128} {
+		for _, batch := range []int{100, 1_000, 10_000} {
+			b.Run(fmt.Sprintf("%s/feat_dim=%d/batch=%d", chariot.KnapsackBackend(), dim, batch), func(b *testing.B) {
+				h, err := chariot.NewRLHandle(fmt.Sprintf(`{"feat_dim": %d, "alpha": 0.3}`, dim), 1)
+				if err != nil {
+					b.Skipf("RL library unavailable: %v", err)
+				}
+				defer h.Close()
+				features := make([]float32, batch*dim)
+				for i := range features {
+					features[i] = float32(i%17) / 17
+				}
+				scores := make([]float64, batch)
+
+				b.ReportAllocs()
+				b.ResetTimer()
+				for i := 0; i < b.N; i++ {
+					if err := h.ScoreInto(features, dim, scores); err != nil {
+						b.Fatal(err)
+					}
+				}
+				b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N*batch), "ns/candidate")
+			})
+		}
+	}
+}
+
+// BenchmarkRLScoreSelect measures tiled feature preparation plus scoring
+// from item masks (rl_prepare_features + rl_score_batch_with_features).
+func BenchmarkRLScoreSelect(b *testing.B) {
+	const items = 20_000
+	for _, batch := range []int{100, 1_000} {
+		b.Run(fmt.Sprintf("%s/items=%d/batch=%d", chariot.KnapsackBackend(), items, batch), func(b *testing.B) {
+			h, err := chariot.NewRLHandle(`{"feat_dim": 16, "alpha": 0.3}`, 1)
+			if err != nil {
+				b.Skipf("RL library unavailable: %v", err)
+			}
+			defer h.Close()
+			masks := make([]byte, batch*items)
+			for i := range masks {
+				masks[i] = byte(i % 3 & 1)
+			}
+			scores := make([]float64, batch)
+
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if _, err := h.ScoreSelect(masks, items, scores, chariot.RLSelectOptions{}); err != nil {
+					b.Fatal(err)
+				}
+			}
+			b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N*batch), "ns/candidate")
+		})
+	}
+}
+
+// BenchmarkRLScoreSparse measures scoring candidates given as index/value
+// pairs (32 per candidate): directly on a "diagonal" handle at any
+// feat_dim, and through tiled expansion on a library handle.
+func BenchmarkRLScoreSparse(b *testing.B) {
+	const batch, nnz = 1_000, 32
+	for _, tc := range []struct {
+		covariance string
+		dim        int
+	}{{"diagonal", 1_024}, {"diagonal", 100_000}, {"library", 1_024}} {
+		b.Run(fmt.Sprintf("%s/%s/feat_dim=%d/batch=%d", chariot.KnapsackBackend(), tc.covariance, tc.dim, batch), func(b *testing.B) {
+			h, err := chariot.NewRLHandle(fmt.Sprintf(`{"feat_dim": %d, "alpha": 0.3, "covariance": %q}`, tc.dim, tc.covariance), 1)
+			if err != nil {
+				b.Skipf("RL library unavailable: %v", err)
+			}
+			defer h.Close()
+			sb := &chariot.RLSparseBatch{Offsets: make([]int32, batch+1)}
+			stride := tc.dim / nnz
+			for c := 0; c < batch; c++ {
+				for k := 0; k < nnz; k++ {
+					sb.Index = append(sb.Index, int32(k*stride+c%stride))
+					sb.Values = append(sb.Values, float32(c%17)/17)
+				}
+				sb.Offsets[c+1] = int32(len(sb.Index))
+			}
+			scores := make([]float64, batch)
+
+			b.ReportAllocs()
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if err := h.ScoreSparseInto(sb, scores); err != nil {
+					b.Fatal(err)
+				}
+			}
+			b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N*batch), "ns/candidate")
+		})
+	}
+}
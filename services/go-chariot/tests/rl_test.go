@@ -1,6 +1,7 @@
 package tests
 
 import (
+	"path/filepath"
 	"testing"
 
 	"github.com/bhouse1273/chariot-ecosystem/services/go-chariot/chariot"
@@ -68,6 +69,73 @@ func TestRLScoring(t *testing.T) {
 			ExpectedError:  true,
 			ErrorSubstring: "not divisible",
 		},
+		{
+			Name: "rlScore - Extra arguments are rejected",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.3}')))`,
+				`rlScore(handle, [1.0, 2.0], 2, float64Buffer(1))`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "rlScore requires 3 arguments",
+		},
+		{
+			Name: "rlScoreInto - Scores a float32Buffer into a float64Buffer",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.5}')))`,
+				`setq(features, float32Buffer([1.0, 2.0, 3.0, 4.0]))`,
+				`setq(scores, float64Buffer(2))`,
+				`rlScoreInto(handle, features, 2, scores)`,
+				`rlClose(handle)`,
+				`length(bufferToArray(scores))`,
+			},
+			ExpectedValue: chariot.Number(2),
+		},
+		{
+			Name: "rlScoreInto - Scores buffer must match candidate count",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.5}')))`,
+				`rlScoreInto(handle, float32Buffer(4), 2, float64Buffer(3))`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "scores buffer length",
+		},
+		{
+			Name: "rlScoreSelect - Retains the best candidate for learning",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 4, "alpha": 0.3}')))`,
+				`setq(r, rlScoreSelect(handle, [[1, 0, 1], [0, 1, 1], [1, 1, 1]], '{"tile": 2, "retain": 1}'))`,
+				`rlLearn(handle, parseJSON('{"rewards": [1.0]}'), getProp(r, "token"))`,
+				`rlClose(handle)`,
+				`length(getProp(r, "retained"))`,
+			},
+			ExpectedValue: chariot.Number(1),
+		},
+		{
+			Name: "rlScoreSelect - Candidates must have the same number of items",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 4, "alpha": 0.3}')))`,
+				`rlScoreSelect(handle, [[1, 0], [1]])`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "has 1 items",
+		},
+		{
+			Name: "bufferSet - Writes one element",
+			Script: []string{
+				`setq(buf, float64Buffer(3))`,
+				`bufferSet(buf, 1, 2.5)`,
+				`bufferGet(buf, 1)`,
+			},
+			ExpectedValue: chariot.Number(2.5),
+		},
+		{
+			Name: "bufferGet - Index out of range",
+			Script: []string{
+				`bufferGet(float32Buffer(2), 2)`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "out of range",
+		},
 	}
 	RunTestCases(t, tests)
 }
@@ -86,10 +154,227 @@ func TestRLLearning(t *testing.T) {
 			},
 			ExpectedValue: chariot.Str("success"),
 		},
+		{
+			Name: "rlLearn - Feedback for an earlier batch token on a sharded handle",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.3, "shards": 2}')))`,
+				`setq(first, rlScoreBatch(handle, [1.0, 2.0, 3.0, 4.0], 2))`,
+				`rlScore(handle, [5.0, 6.0], 2)`,
+				`rlLearn(handle, parseJSON('{"rewards": [1.0, 0.5]}'), getProp(first, "token"))`,
+				`rlClose(handle)`,
+				`length(getProp(first, "scores"))`,
+			},
+			ExpectedValue: chariot.Number(2),
+		},
+		{
+			Name: "rlLearn - Learning on a sharded handle updates every shard",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.3, "shards": 3}')))`,
+				`setq(before, getAt(rlScore(handle, [1.0, 0.0], 2), 0))`,
+				`setq(batch, rlScoreBatch(handle, [1.0, 0.0, 0.0, 1.0], 2))`,
+				`rlLearn(handle, parseJSON('{"rewards": [1.0, 0.0]}'), getProp(batch, "token"))`,
+				`setq(a, getAt(rlScore(handle, [1.0, 0.0], 2), 0))`,
+				`setq(b, getAt(rlScore(handle, [1.0, 0.0], 2), 0))`,
+				`setq(c, getAt(rlScore(handle, [1.0, 0.0], 2), 0))`,
+				`rlClose(handle)`,
+				`and(unequal(a, before), equal(a, b), equal(b, c))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "rlLearn - Sharded handle checks feedback before learning",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.3, "shards": 2}')))`,
+				`setq(batch, rlScoreBatch(handle, [1.0, 0.0], 2))`,
+				`rlLearn(handle, parseJSON('{}'), getProp(batch, "token"))`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "feedback needs rewards",
+		},
+		{
+			Name: "rlLearn - Sharded handle requires a batch token",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.3, "shards": 2}')))`,
+				`rlScore(handle, [1.0, 2.0], 2)`,
+				`rlLearn(handle, parseJSON('{"rewards": [1.0]}'))`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "batch token is required",
+		},
+	}
+	RunTestCases(t, tests)
+}
+
+func TestRLSparse(t *testing.T) {
+	tests := []TestCase{
+		{
+			Name: "rlScoreSparse - Diagonal covariance scores and learns",
+			Script: []string{
+				// Unseen features score alpha (0.3). After one reward of 1 on
+				// feature 3 its mean is 0.5 and its exploration 0.3*sqrt(0.5);
+				// after a reward of 0 on feature 5 only the exploration is left.
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 100000, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`setq(r, rlScoreSparse(handle, [[[3, 1.0]], [[5, 1.0]]]))`,
+				`rlLearn(handle, parseJSON('{"rewards": [1.0, 0.0]}'), getProp(r, "token"))`,
+				`setq(s, getProp(rlScoreSparse(handle, [[[3, 1.0]], [[5, 1.0]], [[17, 1.0]]]), "scores"))`,
+				`and(bigger(getAt(s, 0), 0.7), smaller(getAt(s, 0), 0.72), bigger(getAt(s, 1), 0.21), smaller(getAt(s, 1), 0.22), equal(getAt(s, 2), getAt(getProp(r, "scores"), 0)))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "rlScoreSparse - Library handle",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 4, "alpha": 0.3}')))`,
+				`setq(r, rlScoreSparse(handle, [[[0, 1.0]], [[2, 0.5], [1, 1.0]]]))`,
+				`rlLearn(handle, parseJSON('{"rewards": [1.0, 0.0]}'), getProp(r, "token"))`,
+			},
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "rlScoreSparse - Index out of range",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 4, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`rlScoreSparse(handle, [[[4, 1.0]]])`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "indices must increase",
+		},
+		{
+			Name: "rlInit - Unknown covariance",
+			Script: []string{
+				`rlInit(parseJSON('{"feat_dim": 4, "alpha": 0.3, "covariance": "full"}'))`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "covariance must be",
+		},
+		{
+			Name: "rlLearn - Diagonal covariance requires a batch token",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 2, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`rlScore(handle, [1.0, 2.0], 2)`,
+				`rlLearn(handle, parseJSON('{"rewards": [1.0]}'))`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "batch token is required",
+		},
+	}
+	RunTestCases(t, tests)
+}
+
+func TestRLSnapshot(t *testing.T) {
+	// learned writes a diagonal model to path that has learned a reward of 1
+	// on feature 0 and of 0 on feature 1, and closes it.
+	learned := func(path string) []string {
+		return []string{
+			`setq(src, rlInit(parseJSON('{"feat_dim": 3, "alpha": 0.3, "covariance": "diagonal"}')))`,
+			`setq(r, rlScoreBatch(src, [1.0, 0.0, 0.0, 0.0, 1.0, 0.0], 3))`,
+			`rlLearn(src, parseJSON('{"rewards": [1.0, 0.0]}'), getProp(r, "token"))`,
+			`rlSave(src, "` + path + `")`,
+			`rlClose(src)`,
+		}
+	}
+	dir := t.TempDir()
+	snap := func(name string) string { return filepath.Join(dir, name+".snap") }
+	tests := []TestCase{
+		{
+			Name:          "rlSave - Save a learned diagonal model",
+			Script:        learned(snap("save")),
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "rlLoad - Shared snapshot scores the learned model",
+			Script: append(learned(snap("shared")),
+				`setq(handle, rlLoad("`+snap("shared")+`", "shared"))`,
+				`setq(scores, rlScore(handle, [1.0, 0.0, 0.0, 0.0, 1.0, 0.0], 3))`,
+				`rlClose(handle)`,
+				`bigger(getAt(scores, 0), getAt(scores, 1))`,
+			),
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "rlTakeDelta - Learned features round-trip through rlMergeDelta",
+			Script: append(learned(snap("delta")),
+				`setq(node, rlLoad("`+snap("delta")+`", "shared"))`,
+				`rlTrackDeltas(node)`,
+				`setq(r, rlScoreBatch(node, [0.0, 0.0, 1.0], 3))`,
+				`rlLearn(node, parseJSON('{"rewards": [1.0]}'), getProp(r, "token"))`,
+				`setq(n, rlTakeDelta(node, "`+filepath.Join(dir, "node.delta")+`"))`,
+				`setq(agg, rlLoad("`+snap("delta")+`"))`,
+				`setq(before, getAt(rlScore(agg, [0.0, 0.0, 1.0], 3), 0))`,
+				`rlMergeDelta(agg, "`+filepath.Join(dir, "node.delta")+`")`,
+				`setq(after, getAt(rlScore(agg, [0.0, 0.0, 1.0], 3), 0))`,
+				`setq(ok, and(equal(n, 1), unequal(after, before), equal(after, getAt(rlScore(node, [0.0, 0.0, 1.0], 3), 0))))`,
+				`rlClose(node)`,
+				`rlClose(agg)`,
+				`ok`,
+			),
+			ExpectedValue: chariot.Bool(true),
+		},
+		{
+			Name: "rlTakeDelta - Handles track deltas only when asked",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 3, "alpha": 0.3, "covariance": "diagonal"}')))`,
+				`rlTakeDelta(handle, "` + filepath.Join(dir, "untracked.delta") + `")`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "not tracking deltas",
+		},
+		{
+			Name: "rlSave - Library handles have no state to save",
+			Script: []string{
+				`setq(handle, rlInit(parseJSON('{"feat_dim": 3, "alpha": 0.3}')))`,
+				`rlSave(handle, "` + snap("library") + `")`,
+			},
+			ExpectedError:  true,
+			ErrorSubstring: "only covariance",
+		},
+		{
+			Name: "rlLoad - Invalid mode",
+			Script: append(learned(snap("mode")),
+				`rlLoad("`+snap("mode")+`", "mmap")`,
+			),
+			ExpectedError:  true,
+			ErrorSubstring: "mode must be",
+		},
 	}
 	RunTestCases(t, tests)
 }
 
+// TestRLWriteDeltaFailure checks that a delta whose file can't be written
+// stays pending for the next WriteDelta.
+func TestRLWriteDeltaFailure(t *testing.T) {
+	h, err := chariot.NewRLHandle(`{"feat_dim": 3, "alpha": 0.3, "covariance": "diagonal"}`, 1)
+	if err != nil {
+		t.Fatalf("NewRLHandle: %v", err)
+	}
+	defer h.Close()
+	if err := h.TrackDeltas(); err != nil {
+		t.Fatalf("TrackDeltas: %v", err)
+	}
+	out := make([]float64, 1)
+	token, err := h.ScoreBatch([]float32{1, 0, 1}, 3, out)
+	if err != nil {
+		t.Fatalf("ScoreBatch: %v", err)
+	}
+	if err := h.Learn(`{"rewards": [1.0]}`, token); err != nil {
+		t.Fatalf("Learn: %v", err)
+	}
+	dir := t.TempDir()
+	if _, err := h.WriteDelta(filepath.Join(dir, "missing", "node.delta")); err == nil {
+		t.Fatal("WriteDelta into a missing directory succeeded")
+	}
+	n, err := h.WriteDelta(filepath.Join(dir, "node.delta"))
+	if err != nil {
+		t.Fatalf("WriteDelta: %v", err)
+	}
+	if n != 2 {
+		t.Fatalf("delta after a failed write has %d features, want 2", n)
+	}
+	if _, n, _ = h.TakeDelta(); n != 0 {
+		t.Fatalf("delta after a successful write has %d features, want 0", n)
+	}
+}
+
 func TestRLSelectBest(t *testing.T) {
 	tests := []TestCase{
 		{